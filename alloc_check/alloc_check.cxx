@@ -0,0 +1,160 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Count the allocations of the process
+#include "allocation_counter.hxx"
+
+// Include the decoder to check
+#include "cdr_view.hxx"
+#include "tf_buffer.hxx"
+#include "tf_message_view.hxx"
+
+// The number of messages decoded once the decoder is warmed up
+#define CHECK_NB_MESSAGES 10000
+
+// A TFMessage serialized in plain CDR, with the offset of the stamp of each transform
+struct TfPayload {
+    bool little_endian;
+    std::vector<uint8_t> bytes;
+    std::vector<size_t> stamp_offsets;
+};
+
+// Writes the CDR primitives, aligned relative to the end of the encapsulation header.
+// The messages are written by hand, so that the check only depends on the decoder.
+class CdrWriter {
+   public:
+    explicit CdrWriter(std::vector<uint8_t> &out, bool little_endian) : _out(out), _little_endian(little_endian)
+    {
+        // CDR_BE or CDR_LE, without options
+        _out.assign({0x00, uint8_t(little_endian ? 0x01 : 0x00), 0x00, 0x00});
+    }
+
+    void u32(uint32_t v) { put(v); }
+    void i32(int32_t v) { put(uint32_t(v)); }
+
+    void f64(double v)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        put(bits);
+    }
+
+    void str(std::string_view s)
+    {
+        u32(uint32_t(s.size() + 1));
+        _out.insert(_out.end(), s.begin(), s.end());
+        _out.push_back(0);
+    }
+
+    void align(size_t n)
+    {
+        while ((_out.size() - CDR_ENCAPSULATION_SIZE) % n != 0) {
+            _out.push_back(0);
+        }
+    }
+
+    size_t position() const { return _out.size(); }
+
+   private:
+    template <typename T>
+    void put(T v)
+    {
+        align(sizeof(T));
+        for (size_t i = 0; i < sizeof(T); i++) {
+            size_t byte = _little_endian ? i : sizeof(T) - 1 - i;
+            _out.push_back(uint8_t(v >> (8 * byte)));
+        }
+    }
+
+    std::vector<uint8_t> &_out;
+    bool _little_endian;
+};
+
+// A TFMessage of `nb_transforms` frames, all children of "base_link"
+TfPayload make_tf_message(size_t nb_transforms, bool little_endian)
+{
+    TfPayload payload{little_endian, {}, {}};
+    CdrWriter w(payload.bytes, little_endian);
+    w.u32(uint32_t(nb_transforms));
+    for (size_t i = 0; i < nb_transforms; i++) {
+        w.align(4);
+        payload.stamp_offsets.push_back(w.position());
+        w.i32(0);
+        w.u32(0);
+        w.str("base_link");
+        w.str("frame_" + std::to_string(i));
+        // Translation, then rotation
+        for (double v : {0.1 * double(i), 0.2, 0.3, 0.0, 0.0, 0.0, 1.0}) {
+            w.f64(v);
+        }
+    }
+    return payload;
+}
+
+// Stamp all the transforms with `sec`, as the publishers do with each new message
+void set_stamp(TfPayload &payload, int32_t sec)
+{
+    for (size_t offset : payload.stamp_offsets) {
+        for (size_t i = 0; i < 4; i++) {
+            size_t byte = payload.little_endian ? i : 3 - i;
+            payload.bytes[offset + i] = uint8_t(uint32_t(sec) >> (8 * byte));
+        }
+    }
+}
+
+// Decode the payload and feed the transform cache, as the TF handlers of the subscribers do
+void decode(TfPayload &payload, int32_t sec, TfMessageDecoder &decoder, TfBuffer &buffer)
+{
+    set_stamp(payload, sec);
+    const auto &transforms = decoder.decode(payload.bytes.data(), payload.bytes.size());
+    set_transforms(buffer, transforms, false);
+}
+
+int main()
+{
+    std::printf("TfMessageDecoder allocation check\n");
+
+    bool failed = false;
+    for (bool little_endian : {true, false}) {
+        for (size_t nb_transforms : {1, 10, 100}) {
+            TfPayload payload = make_tf_message(nb_transforms, little_endian);
+            TfBuffer buffer;
+            TfMessageDecoder decoder(buffer.frames());
+            // The first message interns the frame names and sizes the list of transforms
+            decode(payload, 1, decoder, buffer);
+
+            uint64_t allocations_before = nb_allocations.load(std::memory_order_relaxed);
+            uint64_t bytes_before = allocated_bytes.load(std::memory_order_relaxed);
+            for (int32_t i = 0; i < CHECK_NB_MESSAGES; i++) {
+                decode(payload, 2 + i, decoder, buffer);
+            }
+            uint64_t allocations = nb_allocations.load(std::memory_order_relaxed) - allocations_before;
+            uint64_t bytes = allocated_bytes.load(std::memory_order_relaxed) - bytes_before;
+
+            std::printf("%3zu transforms, %s endian: %llu allocations (%llu bytes) in %d messages%s\n", nb_transforms,
+                        little_endian ? "little" : "big", (unsigned long long)allocations, (unsigned long long)bytes,
+                        CHECK_NB_MESSAGES, allocations > 0 ? " FAILED" : "");
+            failed = failed || allocations > 0;
+        }
+    }
+    if (failed) {
+        std::fprintf(stderr, "TfMessageDecoder allocates once warmed up\n");
+        return 1;
+    }
+    return 0;
+}
@@ -10,8 +10,11 @@
 // Contributors:
 //   ChenYing Kuo, <cy@zettascale.tech>
 //
+#include <atomic>
 #include <chrono>
+#include <csignal>
 #include <iostream>
+#include <sstream>
 #include <thread>
 
 // Include Zenoh C++ API
@@ -20,7 +23,31 @@
 // Include args parser
 #include "getargs.hxx"
 
+// Include the CDR helpers
+#include "idl_cdr.hxx"
+#include "point_cloud_view.hxx"
+#include "zenoh_payload.hxx"
+
+// Include the point cloud processing
+#include "point_cloud_fields.hxx"
+#include "voxel_grid.hxx"
+
+// Include the transform cache
+#include "tf_buffer.hxx"
+#include "tf_message_view.hxx"
+#include "tf_static_snapshot.hxx"
+
+// Include the processing pipeline
+#include "pipeline.hxx"
+
+// Include the instrumentation
+#include "topic_metrics.hxx"
+
+// Include the recorder
+#include "mcap_recorder.hxx"
+
 // Include the message types you need
+#include "ros_types.hxx"
 #include "PointCloud2.hpp"
 #include "TFMessage.hpp"
 
@@ -35,6 +62,16 @@ using namespace std::chrono_literals;
 
 #define HISTORY_DEPTH 100
 
+// The queue depth of each topic, matching the QoS of their ROS 2 publishers (Keep last N)
+#define TF_QUEUE_DEPTH          100
+#define TF_STATIC_QUEUE_DEPTH   HISTORY_DEPTH
+#define POINT_CLOUD_QUEUE_DEPTH 5
+
+// Cleared by CTRL-C, so that the recording is completed before exiting
+static std::atomic<bool> running{true};
+
+void stop_running(int) { running = false; }
+
 int main(int argc, char **argv)
 {
     // Initialize Zenoh logging
@@ -43,72 +80,226 @@ int main(int argc, char **argv)
     std::cout << "Zenoh Bridge Subscriber Example" << std::endl;
 
     // Parse the arguments
-    auto &&[config, args] = ConfigCliArgParser(argc, argv).run();
+    auto &&[config, args] = ConfigCliArgParser(argc, argv)
+                                .named_value({"w", "workers"}, "WORKERS", "Number of worker threads processing each topic", "1")
+                                .named_value({"voxel-size"}, "METERS",
+                                             "Downsample the point clouds with a voxel grid of this size (0 to disable)", "0")
+                                .named_values({"tf-lookup"}, "TARGET:SOURCE",
+                                              "Print the latest transform from SOURCE to TARGET frame every second")
+                                .named_value({"stats-period"}, "SECONDS",
+                                             "Period of the statistics log line (0 to disable)", "5")
+                                .named_value({"record"}, "FILE", "Record the raw samples into an MCAP file", "")
+                                .named_value({"record-compression"}, "COMPRESSION",
+                                             "Compression of the recorded chunks (none | zstd)", "none")
+                                .named_value({"record-chunk-size"}, "BYTES", "Size of the recorded chunks",
+                                             std::to_string(MCAP_DEFAULT_CHUNK_SIZE))
+                                .named_value({"record-queue-size"}, "BYTES",
+                                             "Payload bytes waiting to be written before new samples are dropped",
+                                             std::to_string(RECORDER_QUEUE_BYTES))
+                                .named_value({"tf-static-snapshot"}, "FILE",
+                                             "Load the static transforms from FILE at startup, and keep it up to date", "")
+                                .run();
+    size_t nb_workers = std::stoul(std::string(args.value("w")));
+    float voxel_size = std::stof(std::string(args.value("voxel-size")));
+    double stats_period = std::stod(std::string(args.value("stats-period")));
+    std::string record_path(args.value("record"));
+    McapOptions record_options;
+    record_options.compression = parse_mcap_compression(args.value("record-compression"));
+    record_options.chunk_size = std::stoul(std::string(args.value("record-chunk-size")));
+    size_t record_queue_bytes = std::stoul(std::string(args.value("record-queue-size")));
+    std::string snapshot_path(args.value("tf-static-snapshot"));
+
+    std::signal(SIGINT, stop_running);
+    std::signal(SIGTERM, stop_running);
+
+    // The transforms received on /tf and /tf_static are kept in an in-process cache
+    TfBuffer tf_buffer;
+
+    // Start with the static transforms known at the previous run, without waiting for the /tf_static history.
+    // They are replaced as the publishers send them again.
+    std::unique_ptr<TfStaticSnapshot> tf_static_snapshot;
+    if (!snapshot_path.empty()) {
+        tf_static_snapshot = std::make_unique<TfStaticSnapshot>(snapshot_path);
+        try {
+            size_t nb_loaded = tf_static_snapshot->load(tf_buffer);
+            std::cout << "Loaded " << nb_loaded << " static transforms from " << snapshot_path << std::endl;
+        } catch (const std::exception &e) {
+            // The snapshot is only a head start, it's rewritten from the live history
+            std::cerr << "Ignoring the tf_static snapshot: " << e.what() << std::endl;
+        }
+    }
 
     // Initialize Zenoh session with the provided configuration
     auto session = zenoh::Session::open(std::move(config));
 
+    // Each topic is processed by its own pipeline, samples are timestamped when received
+    using SamplePipeline = Pipeline<Timed<zenoh::Sample>>;
+
+    // The statistics of each subscription
+    MetricsRegistry metrics;
+    auto &tf_metrics = metrics.add("tf");
+    auto &tf_static_metrics = metrics.add("tf_static");
+    auto &point_cloud_metrics = metrics.add("point_cloud");
+
+    // Record the samples as they are received, before they are processed
+    std::unique_ptr<McapRecorder> recorder;
+    if (!record_path.empty()) {
+        recorder = std::make_unique<McapRecorder>(record_path, record_options, RECORDER_QUEUE_DEPTH,
+                                                  record_queue_bytes);
+        std::cout << "Recording to " << record_path << std::endl;
+    }
+
     // Subscribe to /tf
     zenoh::KeyExpr tf_keyexpr(ROS_TOPIC_TF);
-    auto tf_handler = [](const zenoh::Sample & sample) {
-        std::cout << ">> [TF Subscriber] Zenoh key: " << sample.get_keyexpr().as_string_view()
-                  << ", Size: " << sample.get_payload().size() << std::endl;
-
-        // Deserialize the CDR payload
-        tf2_msgs::msg::TFMessage tf_msg;
-        basic_cdr_stream stream;
-        // Get the payload and set the buffer for the stream
-        auto buffer = sample.get_payload().as_vector();
-        stream.set_buffer(buffer.data() + 4, buffer.size());
-        // Read the TFMessage from the stream
-        read(stream, tf_msg, key_mode::not_key);
+    auto tf_handler = [&tf_buffer, &tf_static_snapshot](const Timed<zenoh::Sample> &timed, TopicMetrics &metrics, bool is_static) {
+        const zenoh::Sample &sample = timed.value;
+        int64_t queue_ns = system_time_ns() - timed.received_ns;
+        auto start = std::chrono::steady_clock::now();
+
+        // Write the whole report at once, so that the outputs of the workers don't interleave
+        std::ostringstream out;
+        out << ">> [TF Subscriber] Zenoh key: " << sample.get_keyexpr().as_string_view()
+            << ", Size: " << sample.get_payload().size() << "\n";
+
+        // Decode the CDR payload in place, frame names are interned in the transform cache.
+        // Each worker reuses its own decoder, so that decoding doesn't allocate.
+        thread_local TfMessageDecoder decoder(tf_buffer.frames());
+        // Borrow the payload without copying it, unless it's fragmented
+        PayloadView payload(sample.get_payload());
+        try {
+            decoder.decode(payload.span());
+        } catch (const std::exception &e) {
+            std::cerr << "   Failed to deserialize TFMessage: " << e.what() << std::endl;
+            metrics.record_error(payload.size());
+            return;
+        }
+        int64_t decode_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now() - start).count();
+
+        // The transforms of a message are stamped together: the first one tells how old they are.
+        // Static transforms are stamped once and replayed to late joiners, their age is meaningless.
+        std::optional<int64_t> latency_ns;
+        const auto &transforms = decoder.transforms();
+        if (!is_static && !transforms.empty()) {
+            const auto &stamp = transforms.front().header.stamp;
+            if (stamp.sec != 0 || stamp.nanosec != 0) {
+                latency_ns = timed.received_ns - stamp_ns(stamp.sec, stamp.nanosec);
+            }
+        }
+        metrics.record(payload.size(), queue_ns, decode_ns, latency_ns);
+
+        // Update the transform cache
+        set_transforms(tf_buffer, transforms, is_static);
+        if (is_static && tf_static_snapshot) {
+            tf_static_snapshot->update(transforms);
+        }
 
         // Print some information about the TFMessage
-        std::cout << "   Number of transforms: " << tf_msg.transforms().size() << std::endl;
-        for (const auto &transform : tf_msg.transforms()) {
-            std::cout << "   Transform: " << transform.header().stamp()
-                      << ", Frame ID: " << transform.header().frame_id()
-                      << ", Child Frame ID: " << transform.child_frame_id() << std::endl;
-            std::cout << "   Translation: (" 
-                      << transform.transform().translation().x() << ", "
-                      << transform.transform().translation().y() << ", "
-                      << transform.transform().translation().z() << ")" << std::endl;
-            std::cout << "   Rotation: (" 
-                      << transform.transform().rotation().x() << ", "
-                      << transform.transform().rotation().y() << ", "
-                      << transform.transform().rotation().z() << ", "
-                      << transform.transform().rotation().w() << ")" << std::endl;
+        out << "   Number of transforms: " << transforms.size() << "\n";
+        for (const auto &transform : transforms) {
+            out << "   Transform: " << transform.header.stamp
+                << ", Frame ID: " << transform.header.frame_id
+                << ", Child Frame ID: " << transform.child_frame_id << "\n";
+            out << "   Translation: ("
+                << transform.transform.translation.x << ", "
+                << transform.transform.translation.y << ", "
+                << transform.transform.translation.z << ")\n";
+            out << "   Rotation: ("
+                << transform.transform.rotation.x << ", "
+                << transform.transform.rotation.y << ", "
+                << transform.transform.rotation.z << ", "
+                << transform.transform.rotation.w << ")\n";
         }
+        std::cout << out.str();
     }; 
+    // The handler runs on its own workers, the Zenoh callback only hands the sample over.
+    // Cloning a sample only takes a reference on its payload.
+    size_t tf_depth = TF_QUEUE_DEPTH;
+    auto tf_policy = OverflowPolicy::DropOldest;
+    SamplePipeline tf_pipeline("tf", tf_depth, tf_policy, nb_workers,
+                               [&tf_handler, &tf_metrics](const Timed<zenoh::Sample> &timed) {
+                                   tf_handler(timed, tf_metrics, false);
+                               });
+    tf_metrics.track_queue(tf_pipeline);
     auto tf_subscriber = session.declare_subscriber(
                                     tf_keyexpr,               // TF key expression
-                                    std::move(tf_handler),    // The callback to receive sample
+                                    [&tf_pipeline, &recorder](const zenoh::Sample &sample) {
+                                        if (recorder) {
+                                            recorder->record(sample, TF_MESSAGE_TYPE);
+                                        }
+                                        tf_pipeline.push({sample.clone(), system_time_ns()});
+                                    },
                                     zenoh::closures::none     // Drop callback which is not used
                                  );
 
     // Subscribe to /point_cloud
     zenoh::KeyExpr point_cloud_keyexpr(ROS_TOPIC_POINT_CLOUD);
-    auto point_cloud_handler = [](const zenoh::Sample & sample) {
-        std::cout << ">> [Point Cloud Subscriber] Zenoh key: " << sample.get_keyexpr().as_string_view()
-                  << ", Size: " << sample.get_payload().size() << std::endl;
-
-        // Deserialize the CDR payload
-        sensor_msgs::msg::PointCloud2 point_cloud_msg;
-        basic_cdr_stream stream;
-        // Get the payload and set the buffer for the stream
-        auto buffer = sample.get_payload().as_vector();
-        stream.set_buffer(buffer.data() + 4, buffer.size());
-        // Read the PointCloud2 message from the stream
-        read(stream, point_cloud_msg, key_mode::not_key);
+    auto point_cloud_handler = [voxel_size, &point_cloud_metrics](const Timed<zenoh::Sample> &timed) {
+        const zenoh::Sample &sample = timed.value;
+        int64_t queue_ns = system_time_ns() - timed.received_ns;
+        auto start = std::chrono::steady_clock::now();
+
+        std::ostringstream out;
+        out << ">> [Point Cloud Subscriber] Zenoh key: " << sample.get_keyexpr().as_string_view()
+            << ", Size: " << sample.get_payload().size() << "\n";
+
+        // Decode the CDR payload in place: the point data is not copied
+        PayloadView payload(sample.get_payload());
+        PointCloud2View point_cloud;
+        try {
+            point_cloud = PointCloud2View::parse(payload.span());
+        } catch (const std::exception &e) {
+            std::cerr << "   Failed to decode PointCloud2: " << e.what() << std::endl;
+            point_cloud_metrics.record_error(payload.size());
+            return;
+        }
+        int64_t decode_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now() - start).count();
+        const auto &stamp = point_cloud.header().stamp;
+        std::optional<int64_t> latency_ns;
+        if (stamp.sec != 0 || stamp.nanosec != 0) {
+            latency_ns = timed.received_ns - stamp_ns(stamp.sec, stamp.nanosec);
+        }
+        point_cloud_metrics.record(payload.size(), queue_ns, decode_ns, latency_ns);
 
         // Print some information about the PointCloud2 message
-        std::cout << "   Time=" << point_cloud_msg.header().stamp() 
-                  << ", Height=" << point_cloud_msg.height()
-                  << ", Width=" << point_cloud_msg.width() << std::endl;
+        out << "   Time=" << point_cloud.header().stamp
+            << ", Height=" << point_cloud.height()
+            << ", Width=" << point_cloud.width()
+            << ", Fields=" << point_cloud.fields().size()
+            << ", Data=" << point_cloud.data().size << (payload.shared_memory() ? " (shared memory)" : "") << "\n";
+
+        // Unpack the points and downsample them
+        if (voxel_size > 0) {
+            // Each worker reuses its own buffers from one cloud to the next
+            thread_local PointLayoutCache layouts;
+            thread_local PointCloudSoA points;
+            thread_local PointCloudSoA downsampled;
+            thread_local VoxelGrid voxel_grid(voxel_size);
+            const auto &layout = layouts.get(point_cloud);
+            if (layout.has_value()) {
+                unpack_points(point_cloud, *layout, points);
+                voxel_grid.downsample(points, downsampled);
+                out << "   Points=" << points.size() << ", Downsampled=" << downsampled.size() << "\n";
+            } else {
+                out << "   No usable x/y/z fields\n";
+            }
+        }
+        std::cout << out.str();
     }; 
+    size_t point_cloud_depth = POINT_CLOUD_QUEUE_DEPTH;
+    auto point_cloud_policy = OverflowPolicy::DropOldest;
+    SamplePipeline point_cloud_pipeline("point_cloud", point_cloud_depth, point_cloud_policy, nb_workers,
+                                        std::move(point_cloud_handler));
+    point_cloud_metrics.track_queue(point_cloud_pipeline);
     auto point_cloud_subscriber = session.declare_subscriber(
                                             point_cloud_keyexpr,               // Point Cloud key expression
-                                            std::move(point_cloud_handler),    // The callback to receive sample
+                                            [&point_cloud_pipeline, &recorder](const zenoh::Sample &sample) {
+                                                if (recorder) {
+                                                    recorder->record(sample, POINT_CLOUD2_TYPE);
+                                                }
+                                                point_cloud_pipeline.push({sample.clone(), system_time_ns()});
+                                            },
                                             zenoh::closures::none              // Drop callback which is not used
                                           );
 
@@ -124,18 +315,116 @@ int main(int argc, char **argv)
     // Enable detection of late joiner publishers and query for their historical data.
     adv_sub_opts.history->detect_late_publishers = true;
     adv_sub_opts.history->max_samples = HISTORY_DEPTH;
+    // The history of a transient local topic arrives as a burst when publishers are discovered:
+    // make room for all of it, not only for the depth of a single publisher.
+    size_t tf_static_depth = TF_STATIC_QUEUE_DEPTH;
+    auto tf_static_policy = OverflowPolicy::DropOldest;
+    SamplePipeline tf_static_pipeline("tf_static", tf_static_depth, tf_static_policy, nb_workers,
+                                      [&tf_handler, &tf_static_metrics](const Timed<zenoh::Sample> &timed) {
+                                          tf_handler(timed, tf_static_metrics, true);
+                                      });
+    tf_static_metrics.track_queue(tf_static_pipeline);
     zenoh::KeyExpr tf_static_keyexpr(ROS_TOPIC_TF_STATIC);
     auto tf_querying_sub = session.ext().declare_advanced_subscriber(
-                                            tf_static_keyexpr,        // Point Cloud key expression
-                                            std::move(tf_handler),    // The callback to receive sample
+                                            tf_static_keyexpr,        // TF static key expression
+                                            [&tf_static_pipeline, &recorder](const zenoh::Sample &sample) {
+                                                if (recorder) {
+                                                    recorder->record(sample, TF_MESSAGE_TYPE);
+                                                }
+                                                tf_static_pipeline.push({sample.clone(), system_time_ns()});
+                                            },
                                             zenoh::closures::none,    // Drop callback which is not used
                                             std::move(adv_sub_opts)   // Advanced Subscriber configuration
                                          );
+    // Count the samples lost on the way, detected from the gaps in the sequence numbers of the publishers
+    tf_querying_sub.declare_background_sample_miss_listener(
+                        [&tf_static_metrics](const zenoh::ext::Miss &miss) { tf_static_metrics.record_missed(miss.nb); },
+                        zenoh::closures::none
+                    );
+
+    // Expose the statistics of the subscriptions, e.g. `z_get -s '@zenoh_ros_sub/*/stats'`
+    std::stringstream ss_zid;
+    ss_zid << session.get_zid();
+    std::string zid = ss_zid.str();
+    std::string stats_key = "@zenoh_ros_sub/" + zid + "/stats";
+    auto stats_queryable = session.declare_queryable(
+                                zenoh::KeyExpr(stats_key),
+                                [&metrics, stats_key, zid](const zenoh::Query &query) {
+                                    query.reply(zenoh::KeyExpr(stats_key), zenoh::Bytes(metrics.to_json(zid)));
+                                },
+                                zenoh::closures::none
+                            );
 
     // Waiting for CTRL-C to exit
     std::cout << "Press CTRL-C to quit...\n";
-    while (true) {
+    const auto &tf_lookups = args.values("tf-lookup");
+    // The statistics are still collected every second for the queryable when they're not printed
+    auto stats_interval = stats_period > 0 ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                 std::chrono::duration<double>(stats_period))
+                                           : std::chrono::steady_clock::duration(1s);
+    auto next_stats = std::chrono::steady_clock::now() + stats_interval;
+    while (running) {
         std::this_thread::sleep_for(1s);
+
+        // Write the static transforms received since the last second, if they changed the tree
+        if (tf_static_snapshot) {
+            try {
+                tf_static_snapshot->save_if_changed();
+            } catch (const std::exception &e) {
+                std::cerr << "Failed to save the tf_static snapshot: " << e.what() << std::endl;
+            }
+        }
+
+        // Print the statistics of the last period
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next_stats) {
+            auto report = metrics.report();
+            if (stats_period > 0) {
+                std::cout << report;
+                if (recorder) {
+                    std::cout << ">> [Stats] recorder: " << recorder->recorded() << " samples written, "
+                              << recorder->dropped() << " dropped, " << recorder->errors()
+                              << " not written\n";
+                }
+                if (tf_static_snapshot) {
+                    std::cout << ">> [Stats] tf_static snapshot: " << tf_static_snapshot->size() << " transforms, "
+                              << tf_static_snapshot->confirmed() << " loaded ones confirmed\n";
+                }
+            }
+            next_stats = now + stats_interval;
+        }
+
+        // Print the requested transforms
+        for (auto lookup : tf_lookups) {
+            auto pos = lookup.find(':');
+            if (pos == std::string_view::npos) {
+                std::cerr << "Invalid --tf-lookup '" << lookup << "', expected TARGET:SOURCE" << std::endl;
+                continue;
+            }
+            auto target = lookup.substr(0, pos);
+            auto source = lookup.substr(pos + 1);
+            TfError error;
+            auto tf = tf_buffer.lookup(target, source, 0, &error);
+            std::ostringstream out;
+            out << ">> [TF Lookup] " << target << " <- " << source << ": ";
+            if (tf.has_value()) {
+                out << "Translation: (" << tf->translation.x << ", " << tf->translation.y << ", "
+                    << tf->translation.z << "), Rotation: (" << tf->rotation.x << ", " << tf->rotation.y << ", "
+                    << tf->rotation.z << ", " << tf->rotation.w << ")\n";
+            } else {
+                out << to_string(error) << "\n";
+            }
+            std::cout << out.str();
+        }
+    }
+
+    // Keep the static transforms received during the last second
+    if (tf_static_snapshot) {
+        try {
+            tf_static_snapshot->save_if_changed();
+        } catch (const std::exception &e) {
+            std::cerr << "Failed to save the tf_static snapshot: " << e.what() << std::endl;
+        }
     }
 
     return 0;
@@ -0,0 +1,308 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Include args parser
+#include "getargs.hxx"
+
+// Include the decoders to compare
+#include "idl_cdr.hxx"
+#include "point_cloud_fields.hxx"
+#include "point_cloud_view.hxx"
+#include "tf_buffer.hxx"
+#include "tf_message_view.hxx"
+
+// Include the synthetic messages
+#include "synthetic_messages.hxx"
+
+// Count the allocations of each decoder
+#include "allocation_counter.hxx"
+
+#include "PointCloud2.hpp"
+#include "TFMessage.hpp"
+
+// The corpora: TFMessages of a number of transforms, and point clouds of a number of data bytes
+static const size_t TF_SIZES[] = {1, 10, 50, 100, 500};
+static const size_t POINT_CLOUD_SIZES[] = {1 << 10, 16 << 10, 256 << 10, 1 << 20, 4 << 20, 16 << 20};
+
+// Keep the compiler from optimizing away a result which is never used
+template <typename T>
+inline void keep(const T &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// A decoder of a payload of the corpus
+struct BenchCase {
+    std::string message;
+    std::string decoder;
+    // The number of transforms, or the size of the point data
+    size_t size;
+    bool little_endian;
+    size_t payload_size;
+    // Decode the payload `iterations` times
+    std::function<void(size_t)> run;
+    // Once warmed up, the decoder must not allocate: enforced by --check-allocations
+    bool allocation_free;
+
+    std::string name() const
+    {
+        return message + "/" + decoder + "/" + std::to_string(size) + "/" + (little_endian ? "le" : "be");
+    }
+};
+
+struct BenchResult {
+    const BenchCase *bench;
+    size_t iterations;
+    std::vector<double> ns_per_msg;
+    double allocations_per_msg;
+    double allocated_bytes_per_msg;
+
+    double median() const
+    {
+        std::vector<double> sorted = ns_per_msg;
+        std::sort(sorted.begin(), sorted.end());
+        size_t n = sorted.size();
+        return n % 2 == 1 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+    }
+
+    double gb_per_s() const { return double(bench->payload_size) / median(); }
+};
+
+double time_ns(const BenchCase &bench, size_t iterations)
+{
+    auto start = std::chrono::steady_clock::now();
+    bench.run(iterations);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Find the number of iterations lasting at least `min_time_ns`, then time them `repetitions` times
+BenchResult measure(const BenchCase &bench, double min_time_ns, size_t repetitions)
+{
+    // Let the decoders reach their steady state, e.g. intern the frame names and grow their buffers
+    bench.run(1);
+
+    size_t iterations = 1;
+    while (true) {
+        double elapsed = time_ns(bench, iterations);
+        if (elapsed >= min_time_ns || iterations >= (size_t(1) << 30)) {
+            break;
+        }
+        double factor = elapsed > 0 ? 1.2 * min_time_ns / elapsed : 10.0;
+        iterations = std::max(iterations * 2, size_t(double(iterations) * std::min(factor, 10.0)));
+    }
+
+    // The results are reserved beforehand, so that only the decoders are counted
+    BenchResult result{&bench, iterations, {}, 0, 0};
+    result.ns_per_msg.reserve(repetitions);
+    uint64_t allocations_before = nb_allocations.load(std::memory_order_relaxed);
+    uint64_t bytes_before = allocated_bytes.load(std::memory_order_relaxed);
+    for (size_t r = 0; r < repetitions; r++) {
+        result.ns_per_msg.push_back(time_ns(bench, iterations) / double(iterations));
+    }
+    double nb_messages = double(iterations * repetitions);
+    result.allocations_per_msg =
+        double(nb_allocations.load(std::memory_order_relaxed) - allocations_before) / nb_messages;
+    result.allocated_bytes_per_msg = double(allocated_bytes.load(std::memory_order_relaxed) - bytes_before) / nb_messages;
+    return result;
+}
+
+std::string json_report(const std::vector<BenchResult> &results, double min_time_s, size_t repetitions)
+{
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    std::ostringstream out;
+    out << "{\"context\":{\"date\":\"" << date << "\",\"compiler\":\"" << __VERSION__ << "\""
+        << ",\"host_little_endian\":" << (host_is_little_endian() ? "true" : "false")
+        << ",\"min_time_s\":" << min_time_s << ",\"repetitions\":" << repetitions << "},\"benchmarks\":[";
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto &r = results[i];
+        const auto &b = *r.bench;
+        auto minmax = std::minmax_element(r.ns_per_msg.begin(), r.ns_per_msg.end());
+        out << (i > 0 ? "," : "") << "{\"name\":\"" << b.name() << "\",\"message\":\"" << b.message
+            << "\",\"decoder\":\"" << b.decoder << "\",\"size\":" << b.size
+            << ",\"endianness\":\"" << (b.little_endian ? "little" : "big")
+            << "\",\"payload_bytes\":" << b.payload_size << ",\"iterations\":" << r.iterations
+            << ",\"ns_per_msg\":" << r.median() << ",\"ns_per_msg_min\":" << *minmax.first
+            << ",\"ns_per_msg_max\":" << *minmax.second << ",\"gb_per_s\":" << r.gb_per_s()
+            << ",\"allocations_per_msg\":" << r.allocations_per_msg
+            << ",\"allocated_bytes_per_msg\":" << r.allocated_bytes_per_msg << "}";
+    }
+    out << "]}\n";
+    return out.str();
+}
+
+int main(int argc, char **argv)
+{
+    std::cout << "CDR Decoding Benchmark" << std::endl;
+
+    // Parse the arguments
+    auto args = CliArgParser(argc, argv)
+                    .named_value({"f", "filter"}, "SUBSTRING",
+                                 "Only run the benchmarks whose name contains SUBSTRING, e.g. 'TFMessage' or '/be'", "")
+                    .named_value({"min-time"}, "SECONDS", "Minimum duration of each timed repetition", "0.1")
+                    .named_value({"r", "repetitions"}, "NUMBER", "Number of timed repetitions of each benchmark", "3")
+                    .named_value({"json"}, "FILE", "Write the results as JSON into FILE ('-' for stdout)", "")
+                    .named_flag({"check-allocations"},
+                                "Only run the allocation-free decoders, and fail if any of them allocates")
+                    .run();
+    std::string filter(args.value("f"));
+    double min_time_s = std::stod(std::string(args.value("min-time")));
+    size_t repetitions = std::max<size_t>(1, std::stoul(std::string(args.value("r"))));
+    std::string json_path(args.value("json"));
+    bool check_allocations = args.flag("check-allocations");
+
+    // The corpora, in both endiannesses. A decoder of an endianness different from
+    // the host's has to swap every scalar.
+    std::vector<std::unique_ptr<SyntheticPayload>> payloads;
+    std::vector<BenchCase> benches;
+    // Room for the frame names of the largest TFMessage
+    FrameRegistry frames(1024);
+    TfMessageDecoder tf_decoder(frames);
+    PointLayoutCache layouts;
+    PointCloudSoA points;
+    for (bool little_endian : {true, false}) {
+        for (size_t nb_transforms : TF_SIZES) {
+            payloads.push_back(std::make_unique<SyntheticPayload>(make_tf_message(nb_transforms, little_endian)));
+            const auto &bytes = payloads.back()->bytes();
+            auto add = [&](std::string decoder, std::function<void(size_t)> run, bool allocation_free = false) {
+                benches.push_back(
+                    {"TFMessage", std::move(decoder), nb_transforms, little_endian, bytes.size(), run, allocation_free});
+            };
+            // The idlcxx types, as the subscribers used to decode: a new message each time...
+            add("read_idl", [&bytes](size_t n) {
+                for (size_t i = 0; i < n; i++) {
+                    tf2_msgs::msg::TFMessage msg;
+                    read_idl(bytes.data(), bytes.size(), msg);
+                    keep(msg.transforms().size());
+                }
+            });
+            // ... or a message reused from one payload to the next
+            add("read_idl_reused", [&bytes](size_t n) {
+                tf2_msgs::msg::TFMessage msg;
+                for (size_t i = 0; i < n; i++) {
+                    read_idl(bytes.data(), bytes.size(), msg);
+                    keep(msg.transforms().size());
+                }
+            });
+            // In place, with the frame names interned
+            add("TfMessageDecoder", [&bytes, &tf_decoder](size_t n) {
+                for (size_t i = 0; i < n; i++) {
+                    keep(tf_decoder.decode(bytes.data(), bytes.size()).size());
+                }
+            }, true);
+        }
+        for (size_t data_size : POINT_CLOUD_SIZES) {
+            payloads.push_back(std::make_unique<SyntheticPayload>(make_point_cloud(data_size, little_endian)));
+            const auto &bytes = payloads.back()->bytes();
+            auto add = [&](std::string decoder, std::function<void(size_t)> run, bool allocation_free = false) {
+                benches.push_back(
+                    {"PointCloud2", std::move(decoder), data_size, little_endian, bytes.size(), run, allocation_free});
+            };
+            add("read_idl", [&bytes](size_t n) {
+                for (size_t i = 0; i < n; i++) {
+                    sensor_msgs::msg::PointCloud2 msg;
+                    read_idl(bytes.data(), bytes.size(), msg);
+                    keep(msg.data().size());
+                }
+            });
+            add("read_idl_reused", [&bytes](size_t n) {
+                sensor_msgs::msg::PointCloud2 msg;
+                for (size_t i = 0; i < n; i++) {
+                    read_idl(bytes.data(), bytes.size(), msg);
+                    keep(msg.data().size());
+                }
+            });
+            // In place: the point data is not touched
+            add("PointCloud2View", [&bytes](size_t n) {
+                for (size_t i = 0; i < n; i++) {
+                    keep(PointCloud2View::parse(bytes.data(), bytes.size()).data().size);
+                }
+            }, true);
+            // In place, then x/y/z/intensity unpacked into reused arrays, as with --voxel-size
+            add("PointCloud2View+unpack_points", [&bytes, &layouts, &points](size_t n) {
+                for (size_t i = 0; i < n; i++) {
+                    auto cloud = PointCloud2View::parse(bytes.data(), bytes.size());
+                    unpack_points(cloud, *layouts.get(cloud), points);
+                    keep(points.x.data());
+                }
+            }, true);
+        }
+    }
+
+    std::vector<BenchResult> results;
+    results.reserve(benches.size());
+    std::printf("%-50s %14s %10s %12s %14s\n", "benchmark", "ns/msg", "GB/s", "allocs/msg", "alloc B/msg");
+    for (const auto &bench : benches) {
+        if (!filter.empty() && bench.name().find(filter) == std::string::npos) {
+            continue;
+        }
+        if (check_allocations && !bench.allocation_free) {
+            continue;
+        }
+        auto result = measure(bench, min_time_s * 1e9, repetitions);
+        std::printf("%-50s %14.1f %10.3f %12.2f %14.1f\n", bench.name().c_str(), result.median(), result.gb_per_s(),
+                    result.allocations_per_msg, result.allocated_bytes_per_msg);
+        std::fflush(stdout);
+        results.push_back(std::move(result));
+    }
+
+    if (!json_path.empty()) {
+        auto json = json_report(results, min_time_s, repetitions);
+        if (json_path == "-") {
+            std::cout << json;
+        } else {
+            std::ofstream file(json_path);
+            file << json;
+            if (!file) {
+                std::cerr << "Failed to write " << json_path << std::endl;
+                return 1;
+            }
+            std::cout << "Results written to " << json_path << std::endl;
+        }
+    }
+
+    if (check_allocations) {
+        size_t nb_failed = 0;
+        for (const auto &r : results) {
+            if (r.allocations_per_msg > 0) {
+                std::cerr << "FAILED: " << r.bench->name() << " allocates " << r.allocations_per_msg
+                          << " times per message once warmed up" << std::endl;
+                nb_failed++;
+            }
+        }
+        if (nb_failed > 0 || results.empty()) {
+            std::cerr << (results.empty() ? "No allocation-free decoder was run" : "Allocation check failed")
+                      << std::endl;
+            return 1;
+        }
+        std::cout << "Allocation check passed: " << results.size() << " decoders don't allocate once warmed up"
+                  << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,73 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Every allocation of the process is counted, by replacing the global operator new, to tell
+// which decoders allocate per message. The replacements can't be inline: include this header
+// in a single translation unit of the executable.
+// The counters are atomic, so that they stay correct if other threads allocate too.
+static std::atomic<uint64_t> nb_allocations{0};
+static std::atomic<uint64_t> allocated_bytes{0};
+
+void *counted_alloc(size_t size, size_t alignment = 0)
+{
+    nb_allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (size == 0) {
+        size = 1;
+    }
+    if (alignment > alignof(std::max_align_t)) {
+        // aligned_alloc wants a multiple of the alignment
+        return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    }
+    return std::malloc(size);
+}
+
+void *operator new(size_t size)
+{
+    void *p = counted_alloc(size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return counted_alloc(size); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return counted_alloc(size); }
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+    void *p = counted_alloc(size, size_t(alignment));
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) { return operator new(size, alignment); }
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { std::free(p); }
@@ -0,0 +1,200 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// A read-only view over a contiguous range of bytes.
+struct ByteSpan {
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+
+    const uint8_t *begin() const { return data; }
+    const uint8_t *end() const { return data + size; }
+    bool empty() const { return size == 0; }
+};
+
+// The length of the encapsulation header which prefixes every serialized payload.
+#define CDR_ENCAPSULATION_SIZE 4
+
+// The encapsulation header defined in DDS-RTPS 10.5 and DDS-XTypes 7.6.3.1.2.
+// ROS 2 publishers send plain CDR (little endian on all supported hosts), but
+// we also accept big endian and the final-extensibility form of XCDR2.
+struct CdrEncapsulation {
+    bool little_endian;
+    // XCDR2 caps the alignment of 8-byte primitives to 4
+    size_t max_align;
+    uint16_t options;
+};
+
+inline bool host_is_little_endian()
+{
+    const uint16_t probe = 1;
+    uint8_t first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+inline CdrEncapsulation parse_cdr_encapsulation(const uint8_t *buf, size_t len)
+{
+    if (len < CDR_ENCAPSULATION_SIZE) {
+        throw std::runtime_error("CDR payload is shorter than the encapsulation header");
+    }
+    uint16_t id = (uint16_t(buf[0]) << 8) | buf[1];
+    uint16_t options = (uint16_t(buf[2]) << 8) | buf[3];
+    switch (id) {
+        case 0x0000:  // CDR_BE
+            return {false, 8, options};
+        case 0x0001:  // CDR_LE
+            return {true, 8, options};
+        case 0x0006:  // CDR2_BE
+            return {false, 4, options};
+        case 0x0007:  // CDR2_LE
+            return {true, 4, options};
+        default:
+            // Parameter lists and delimited CDR only show up with mutable/appendable types,
+            // which none of the ROS 2 messages we handle are.
+            throw std::runtime_error("Unsupported CDR encapsulation: " + std::to_string(id));
+    }
+}
+
+// A minimal cursor to decode CDR primitives in place.
+// Alignment is computed relative to the first byte after the encapsulation
+// header, and strings/octet sequences are returned as views into the buffer.
+class CdrReader {
+   public:
+    CdrReader(const uint8_t *payload, size_t len)
+    {
+        auto encap = parse_cdr_encapsulation(payload, len);
+        _base = payload + CDR_ENCAPSULATION_SIZE;
+        _size = len - CDR_ENCAPSULATION_SIZE;
+        _swap = encap.little_endian != host_is_little_endian();
+        _max_align = encap.max_align;
+        _little_endian = encap.little_endian;
+    }
+
+    explicit CdrReader(ByteSpan payload) : CdrReader(payload.data, payload.size) {}
+
+    bool little_endian() const { return _little_endian; }
+    size_t position() const { return _pos; }
+    size_t remaining() const { return _size - _pos; }
+
+    uint8_t read_u8()
+    {
+        require(1);
+        return _base[_pos++];
+    }
+
+    bool read_bool() { return read_u8() != 0; }
+
+    uint16_t read_u16() { return read_primitive<uint16_t>(); }
+    uint32_t read_u32() { return read_primitive<uint32_t>(); }
+    int32_t read_i32() { return static_cast<int32_t>(read_primitive<uint32_t>()); }
+    uint64_t read_u64() { return read_primitive<uint64_t>(); }
+
+    float read_f32()
+    {
+        uint32_t bits = read_primitive<uint32_t>();
+        float v;
+        std::memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+
+    double read_f64()
+    {
+        uint64_t bits = read_primitive<uint64_t>();
+        double v;
+        std::memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+
+    // The serialized length includes the terminating NUL, which is not part of the view.
+    std::string_view read_string()
+    {
+        uint32_t len = read_u32();
+        if (len == 0) {
+            return {};
+        }
+        require(len);
+        std::string_view s(reinterpret_cast<const char *>(_base + _pos), len - 1);
+        _pos += len;
+        return s;
+    }
+
+    ByteSpan read_octets(size_t len)
+    {
+        require(len);
+        ByteSpan s{_base + _pos, len};
+        _pos += len;
+        return s;
+    }
+
+    // Read the length of a sequence, checking that at least `min_elem_size` bytes per element remain.
+    uint32_t read_sequence_length(size_t min_elem_size = 1)
+    {
+        uint32_t n = read_u32();
+        if (min_elem_size != 0 && n > remaining() / min_elem_size) {
+            throw std::runtime_error("CDR sequence length exceeds the payload size");
+        }
+        return n;
+    }
+
+    void skip(size_t len)
+    {
+        require(len);
+        _pos += len;
+    }
+
+    void align(size_t n)
+    {
+        n = n < _max_align ? n : _max_align;
+        size_t pad = (n - (_pos % n)) % n;
+        require(pad);
+        _pos += pad;
+    }
+
+   private:
+    template <typename T>
+    T read_primitive()
+    {
+        align(sizeof(T));
+        require(sizeof(T));
+        T v;
+        std::memcpy(&v, _base + _pos, sizeof(T));
+        _pos += sizeof(T);
+        return _swap ? byte_swap(v) : v;
+    }
+
+    static uint16_t byte_swap(uint16_t v) { return __builtin_bswap16(v); }
+    static uint32_t byte_swap(uint32_t v) { return __builtin_bswap32(v); }
+    static uint64_t byte_swap(uint64_t v) { return __builtin_bswap64(v); }
+
+    void require(size_t len) const
+    {
+        if (len > _size - _pos) {
+            throw std::runtime_error("CDR payload is truncated");
+        }
+    }
+
+    const uint8_t *_base = nullptr;
+    size_t _size = 0;
+    size_t _pos = 0;
+    size_t _max_align = 8;
+    bool _swap = false;
+    bool _little_endian = true;
+};
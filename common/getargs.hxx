@@ -354,6 +354,9 @@ class ConfigCliArgParser : public CliArgParser {
         named_value({"m", "mode"}, "MODE", "Zenoh session mode (peer | client)", "client");
 #endif
         named_flag({"no-multicast-scouting"}, "Disable the multicast-based scouting mechanism");
+#ifdef ZENOHCXX_ZENOHC
+        named_flag({"shm"}, "Enable the shared memory transport with the Zenoh nodes on the same host");
+#endif
         named_flag({"h", "help"}, "Print help");
 
         auto result = CliArgParser::run();
@@ -387,6 +390,10 @@ class ConfigCliArgParser : public CliArgParser {
         if (result.flag("no-multicast-scouting")) {
             config.insert_json5(Z_CONFIG_MULTICAST_SCOUTING_KEY, "false");
         }
+        if (result.flag("shm")) {
+            // Only effective if zenoh-c is built with the shared-memory feature, and if the other side enables it too
+            config.insert_json5("transport/shared_memory/enabled", "true");
+        }
 
         for (auto c : result.values("cfg")) {
             auto pos = c.find(':');
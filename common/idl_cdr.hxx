@@ -0,0 +1,73 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include <org/eclipse/cyclonedds/core/cdr/basic_cdr_ser.hpp>
+
+#include "cdr_view.hxx"
+
+// Deserialize a CDR payload, including its encapsulation header, into an idlcxx-generated type.
+// The stream is configured with the endianness announced by the header and
+// bounded to the actual size of the serialized data.
+template <typename T>
+bool read_idl(const uint8_t *payload, size_t len, T &msg)
+{
+    using namespace org::eclipse::cyclonedds::core::cdr;
+
+    auto encap = parse_cdr_encapsulation(payload, len);
+    if (encap.max_align != 8) {
+        // basic_cdr_stream only implements XCDR1
+        throw std::runtime_error("XCDR2 payloads are not supported by read_idl()");
+    }
+    basic_cdr_stream stream(encap.little_endian ? endianness::little_endian : endianness::big_endian);
+    // The stream API is not const-correct but doesn't modify the buffer while reading
+    stream.set_buffer(const_cast<uint8_t *>(payload) + CDR_ENCAPSULATION_SIZE, len - CDR_ENCAPSULATION_SIZE);
+    return read(stream, msg, key_mode::not_key);
+}
+
+template <typename T>
+bool read_idl(ByteSpan payload, T &msg)
+{
+    return read_idl(payload.data, payload.size, msg);
+}
+
+// Serialize an idlcxx-generated type into a CDR payload, prefixed with its encapsulation header
+template <typename T>
+std::vector<uint8_t> write_idl(const T &msg, bool little_endian = host_is_little_endian())
+{
+    using namespace org::eclipse::cyclonedds::core::cdr;
+
+    auto end = little_endian ? endianness::little_endian : endianness::big_endian;
+    // A first pass computes the serialized size
+    basic_cdr_stream sizer(end);
+    if (!move(sizer, msg, key_mode::not_key)) {
+        throw std::runtime_error("Failed to compute the serialized size of the message");
+    }
+    size_t size = sizer.position();
+
+    std::vector<uint8_t> payload(CDR_ENCAPSULATION_SIZE + size);
+    payload[0] = 0x00;
+    payload[1] = little_endian ? 0x01 : 0x00;  // CDR_LE or CDR_BE
+    payload[2] = 0x00;
+    payload[3] = 0x00;
+    basic_cdr_stream stream(end);
+    stream.set_buffer(payload.data() + CDR_ENCAPSULATION_SIZE, size);
+    if (!write(stream, msg, key_mode::not_key)) {
+        throw std::runtime_error("Failed to serialize the message");
+    }
+    return payload;
+}
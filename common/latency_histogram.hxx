@@ -0,0 +1,178 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+// A log-linear histogram in the spirit of HdrHistogram.
+// Values below 2^SubBits are counted exactly; above that, each power of two
+// is split in 2^SubBits buckets, which bounds the relative error to 2^-SubBits.
+// Values from 2^MaxBits on share the last bucket. The buckets are only
+// allocated by the first record, and recording is a couple of bit operations
+// and an increment.
+template <unsigned SubBits, unsigned MaxBits>
+class BasicLatencyHistogram {
+   public:
+    static_assert(SubBits < MaxBits && MaxBits <= 64, "Invalid histogram precision");
+    static constexpr unsigned SUB_BITS = SubBits;
+    static constexpr unsigned MAX_BITS = MaxBits;
+    static constexpr uint64_t SUB_COUNT = uint64_t(1) << SUB_BITS;
+    static constexpr uint64_t MAX_VALUE =
+        MAX_BITS == 64 ? std::numeric_limits<uint64_t>::max() : (uint64_t(1) << (MAX_BITS % 64)) - 1;
+    static constexpr size_t NB_BUCKETS = SUB_COUNT + (MAX_BITS - SUB_BITS) * SUB_COUNT;
+
+    BasicLatencyHistogram() = default;
+
+    BasicLatencyHistogram(const BasicLatencyHistogram &other) { merge(other); }
+    BasicLatencyHistogram &operator=(const BasicLatencyHistogram &other)
+    {
+        if (this != &other) {
+            reset();
+            merge(other);
+        }
+        return *this;
+    }
+    // The moved-from histogram is left empty, without buckets
+    BasicLatencyHistogram(BasicLatencyHistogram &&other) noexcept
+        : _counts(std::move(other._counts)), _total(other._total), _sum(other._sum), _min(other._min),
+          _max(other._max)
+    {
+        other.clear_totals();
+    }
+    BasicLatencyHistogram &operator=(BasicLatencyHistogram &&other) noexcept
+    {
+        if (this != &other) {
+            _counts = std::move(other._counts);
+            _total = other._total;
+            _sum = other._sum;
+            _min = other._min;
+            _max = other._max;
+            other.clear_totals();
+        }
+        return *this;
+    }
+
+    static size_t bucket_of(uint64_t v)
+    {
+        v = std::min(v, MAX_VALUE);
+        if (v < SUB_COUNT) {
+            return size_t(v);
+        }
+        unsigned exp = 63 - __builtin_clzll(v);
+        unsigned shift = exp - SUB_BITS;
+        return size_t(SUB_COUNT + (exp - SUB_BITS) * SUB_COUNT + ((v >> shift) - SUB_COUNT));
+    }
+
+    // The highest value counted in a bucket
+    static uint64_t upper_bound_of(size_t bucket)
+    {
+        if (bucket < SUB_COUNT) {
+            return bucket;
+        }
+        size_t b = bucket - SUB_COUNT;
+        unsigned shift = unsigned(b / SUB_COUNT);
+        uint64_t sub = SUB_COUNT + b % SUB_COUNT;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    void record(uint64_t v) { record(v, 1); }
+
+    void record(uint64_t v, uint64_t n)
+    {
+        allocate();
+        _counts[bucket_of(v)] += n;
+        _total += n;
+        _sum += v * n;
+        _min = std::min(_min, v);
+        _max = std::max(_max, v);
+    }
+
+    void merge(const BasicLatencyHistogram &other)
+    {
+        if (other._total == 0) {
+            return;
+        }
+        allocate();
+        for (size_t i = 0; i < NB_BUCKETS; i++) {
+            _counts[i] += other._counts[i];
+        }
+        _total += other._total;
+        _sum += other._sum;
+        _min = std::min(_min, other._min);
+        _max = std::max(_max, other._max);
+    }
+
+    // Keeps the buckets allocated
+    void reset()
+    {
+        if (_counts) {
+            std::fill(_counts.get(), _counts.get() + NB_BUCKETS, 0);
+        }
+        clear_totals();
+    }
+
+    uint64_t count() const { return _total; }
+    uint64_t min() const { return _total == 0 ? 0 : _min; }
+    uint64_t max() const { return _max; }
+    double mean() const { return _total == 0 ? 0.0 : double(_sum) / double(_total); }
+
+    // The value below which `p` percent of the recorded values fall, e.g. percentile(99.9)
+    uint64_t percentile(double p) const
+    {
+        if (_total == 0) {
+            return 0;
+        }
+        uint64_t rank = uint64_t(p / 100.0 * double(_total) + 0.5);
+        rank = std::clamp<uint64_t>(rank, 1, _total);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < NB_BUCKETS; i++) {
+            seen += _counts[i];
+            if (seen >= rank) {
+                return std::min(upper_bound_of(i), _max);
+            }
+        }
+        return _max;
+    }
+
+   private:
+    void clear_totals()
+    {
+        _total = 0;
+        _sum = 0;
+        _min = std::numeric_limits<uint64_t>::max();
+        _max = 0;
+    }
+
+    void allocate()
+    {
+        if (!_counts) {
+            _counts.reset(new uint64_t[NB_BUCKETS]());
+        }
+    }
+
+    std::unique_ptr<uint64_t[]> _counts;
+    uint64_t _total = 0;
+    uint64_t _sum = 0;
+    uint64_t _min = std::numeric_limits<uint64_t>::max();
+    uint64_t _max = 0;
+};
+
+// The precision of the benchmarks: ~0.8% over the whole uint64 range, 59 KB once allocated
+using LatencyHistogram = BasicLatencyHistogram<7, 64>;
+// The precision of the per-topic metrics, for thousands of topics:
+// ~3% up to 2^40 ns (about 18 minutes), 9 KB once allocated
+using CompactHistogram = BasicLatencyHistogram<5, 40>;
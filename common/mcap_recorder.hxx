@@ -0,0 +1,169 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "zenoh.hxx"
+
+#include "mcap_writer.hxx"
+#include "pipeline.hxx"
+#include "ros_types.hxx"
+#include "topic_metrics.hxx"
+
+// The number of samples waiting for the I/O thread before new ones are dropped
+#define RECORDER_QUEUE_DEPTH 1024
+// The payload bytes waiting for the I/O thread before new samples are dropped
+#define RECORDER_QUEUE_BYTES (256 * 1024 * 1024)
+
+// Records the raw CDR payloads of Zenoh samples into an MCAP file.
+// Nothing is deserialized: the Zenoh callback only takes a reference on the
+// sample, and the I/O thread copies its payload slices straight into the
+// mapped file. Each key expression gets its own channel, tagged with the key
+// and the type hash, and messages are stamped with their reception time.
+// The recording stops at the first write error, e.g. when the disk is full.
+class McapRecorder {
+   public:
+    McapRecorder(const std::string &path, McapOptions options = {}, size_t queue_depth = RECORDER_QUEUE_DEPTH,
+                 size_t queue_bytes = RECORDER_QUEUE_BYTES)
+        : _writer(path, options),
+          _queue_bytes(queue_bytes),
+          // Keep what's already queued when the disk doesn't keep up, so that recorded sequences have no holes
+          _io("recorder", queue_depth, OverflowPolicy::DropNewest, 1, [this](Item &item) { write(item); })
+    {
+    }
+
+    McapRecorder(const McapRecorder &) = delete;
+    McapRecorder &operator=(const McapRecorder &) = delete;
+
+    // Called from the Zenoh callbacks
+    void record(const zenoh::Sample &sample, const RosType &type)
+    {
+        // The depth alone doesn't bound the memory when the samples are point clouds: the bytes are counted too.
+        // A sample larger than the budget is still taken when nothing else is queued.
+        size_t size = sample.get_payload().size();
+        size_t queued = _queued_bytes.fetch_add(size, std::memory_order_relaxed);
+        if (queued > 0 && queued + size > _queue_bytes) {
+            _queued_bytes.fetch_sub(size, std::memory_order_relaxed);
+            _over_budget.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (!_io.push(Item{{sample.clone(), system_time_ns()}, &type, size})) {
+            _queued_bytes.fetch_sub(size, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t recorded() const { return _recorded.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return _io.dropped() + _over_budget.load(std::memory_order_relaxed); }
+    // The samples which couldn't be written
+    uint64_t errors() const { return _errors.load(std::memory_order_relaxed); }
+
+   private:
+    struct Item {
+        Timed<zenoh::Sample> sample;
+        const RosType *type;
+        size_t size;
+    };
+
+    struct KeyChannel {
+        std::string key;
+        uint16_t channel;
+    };
+
+    // The Zenoh HLC timestamps are NTP64: seconds in the high 32 bits, fraction of a second in the low ones
+    static uint64_t ntp64_to_ns(uint64_t t) { return (t >> 32) * 1000000000 + (((t & 0xFFFFFFFF) * 1000000000) >> 32); }
+
+    uint16_t channel_for(std::string_view key, const RosType &type)
+    {
+        // A handful of keys: a linear search avoids building a std::string per sample
+        for (const auto &kc : _channels) {
+            if (kc.key == key) {
+                return kc.channel;
+            }
+        }
+        std::string type_name = ros_type_name(type.dds_name);
+        uint16_t schema_id = 0;
+        if (type.definition != nullptr) {
+            for (const auto &[name, id] : _schemas) {
+                if (name == type_name) {
+                    schema_id = id;
+                }
+            }
+            if (schema_id == 0) {
+                schema_id = _writer.add_schema(type_name, "ros2msg", type.definition);
+                _schemas.emplace_back(type_name, schema_id);
+            }
+        }
+        uint16_t channel = _writer.add_channel(schema_id, ros_topic_of_key(key), "cdr",
+                                               {{"zenoh_key", std::string(key)}, {"type_hash", type.hash}});
+        _channels.push_back(KeyChannel{std::string(key), channel});
+        return channel;
+    }
+
+    // Runs on the I/O thread
+    void write(Item &item)
+    {
+        if (!_failed) {
+            try {
+                write_sample(item);
+            } catch (const std::exception &e) {
+                std::cerr << "[recorder] Failed to write the MCAP file, the recording is stopped: " << e.what()
+                          << std::endl;
+                _failed = true;
+            }
+        }
+        if (_failed) {
+            _errors.fetch_add(1, std::memory_order_relaxed);
+        }
+        _queued_bytes.fetch_sub(item.size, std::memory_order_relaxed);
+    }
+
+    void write_sample(const Item &item)
+    {
+        const zenoh::Sample &sample = item.sample.value;
+        uint16_t channel = channel_for(sample.get_keyexpr().as_string_view(), *item.type);
+
+        _slices.clear();
+        auto it = sample.get_payload().slice_iter();
+        for (auto s = it.next(); s.has_value(); s = it.next()) {
+            _slices.push_back(ByteSpan{s->data, s->len});
+        }
+        uint64_t log_time = uint64_t(item.sample.received_ns);
+        uint64_t publish_time = log_time;
+        if (auto ts = sample.get_timestamp(); ts.has_value()) {
+            publish_time = ntp64_to_ns(ts->get().get_ntp64_time());
+        }
+        _writer.write_message(channel, log_time, publish_time, _slices.data(), _slices.size());
+        _recorded.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Only used by the I/O thread, and closed once it has drained the queue
+    McapWriter _writer;
+    std::vector<KeyChannel> _channels;
+    std::vector<std::pair<std::string, uint16_t>> _schemas;
+    std::vector<ByteSpan> _slices;
+    bool _failed = false;
+    size_t _queue_bytes;
+    std::atomic<size_t> _queued_bytes{0};
+    std::atomic<uint64_t> _over_budget{0};
+    std::atomic<uint64_t> _recorded{0};
+    std::atomic<uint64_t> _errors{0};
+    // Declared last, so that it's stopped first
+    Pipeline<Item> _io;
+};
@@ -0,0 +1,641 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#ifdef ZENOH_ROS_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include "cdr_view.hxx"
+
+// A writer of MCAP files (https://mcap.dev/spec), as recorded by rosbag2 with the "ros2" profile.
+// Messages are appended as raw bytes to chunks, each followed by its message indexes,
+// and a summary (schemas, channels, statistics and chunk indexes) is written when the
+// file is closed, so that it can be read back by `ros2 bag`, Foxglove or the mcap CLI.
+// The file is memory-mapped: uncompressed chunks are written directly in place.
+
+#define MCAP_MAGIC      "\x89MCAP0\r\n"
+#define MCAP_MAGIC_SIZE 8
+#define MCAP_PROFILE    "ros2"
+#define MCAP_LIBRARY    "zenoh-ros-examples"
+
+// The uncompressed size above which a chunk is closed
+#define MCAP_DEFAULT_CHUNK_SIZE (4 * 1024 * 1024)
+// The file is grown and remapped by steps of this size
+#define MCAP_FILE_GROWTH (64 * 1024 * 1024)
+
+#define MCAP_OP_HEADER        0x01
+#define MCAP_OP_FOOTER        0x02
+#define MCAP_OP_SCHEMA        0x03
+#define MCAP_OP_CHANNEL       0x04
+#define MCAP_OP_MESSAGE       0x05
+#define MCAP_OP_CHUNK         0x06
+#define MCAP_OP_MESSAGE_INDEX 0x07
+#define MCAP_OP_CHUNK_INDEX   0x08
+#define MCAP_OP_STATISTICS    0x0B
+#define MCAP_OP_DATA_END      0x0F
+
+// Opcode and length of a record
+#define MCAP_RECORD_PREFIX_SIZE 9
+
+enum class McapCompression { None, Zstd };
+
+inline McapCompression parse_mcap_compression(std::string_view v)
+{
+    if (v == "none") {
+        return McapCompression::None;
+    } else if (v == "zstd") {
+#ifdef ZENOH_ROS_WITH_ZSTD
+        return McapCompression::Zstd;
+#else
+        throw std::runtime_error("zstd compression is not available: rebuild with libzstd installed");
+#endif
+    }
+    throw std::runtime_error(std::string("Unsupported MCAP compression: ") + std::string(v));
+}
+
+inline const char *to_string(McapCompression c) { return c == McapCompression::Zstd ? "zstd" : ""; }
+
+struct McapOptions {
+    size_t chunk_size = MCAP_DEFAULT_CHUNK_SIZE;
+    McapCompression compression = McapCompression::None;
+};
+
+// A file written through a shared memory mapping, which grows as needed
+class MappedFile {
+   public:
+    explicit MappedFile(const std::string &path)
+    {
+        _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (_fd < 0) {
+            throw std::runtime_error("Failed to open " + path + ": " + std::strerror(errno));
+        }
+    }
+
+    ~MappedFile() { close(_size); }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // A pointer to [offset, offset + len), valid until the next call
+    uint8_t *at(size_t offset, size_t len)
+    {
+        if (offset + len > _capacity) {
+            grow(offset + len);
+        }
+        if (offset + len > _size) {
+            _size = offset + len;
+        }
+        return _data + offset;
+    }
+
+    // Unmap the file and truncate it to `size`
+    void close(size_t size)
+    {
+        if (_fd < 0) {
+            return;
+        }
+        if (_data != nullptr) {
+            ::munmap(_data, _capacity);
+            _data = nullptr;
+        }
+        if (::ftruncate(_fd, off_t(size)) != 0) {
+            // Only the trailing padding is left, the content is complete
+        }
+        ::close(_fd);
+        _fd = -1;
+    }
+
+   private:
+    void grow(size_t min_capacity)
+    {
+        size_t capacity = (min_capacity + MCAP_FILE_GROWTH - 1) / MCAP_FILE_GROWTH * MCAP_FILE_GROWTH;
+        // Allocate the blocks now: a full disk would otherwise only show up as a SIGBUS when writing to the mapping
+        int err = ::posix_fallocate(_fd, off_t(_capacity), off_t(capacity - _capacity));
+        if (err != 0) {
+            throw std::runtime_error(std::string("Failed to grow the MCAP file: ") + std::strerror(err));
+        }
+        void *data = _data == nullptr ? ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0)
+                                      : ::mremap(_data, _capacity, capacity, MREMAP_MAYMOVE);
+        if (data == MAP_FAILED) {
+            throw std::runtime_error(std::string("Failed to map the MCAP file: ") + std::strerror(errno));
+        }
+        _data = static_cast<uint8_t *>(data);
+        _capacity = capacity;
+    }
+
+    int _fd = -1;
+    uint8_t *_data = nullptr;
+    size_t _capacity = 0;
+    size_t _size = 0;
+};
+
+// Serializes the little endian fields of MCAP records
+class McapCursor {
+   public:
+    explicit McapCursor(uint8_t *p) : _p(p) {}
+
+    void u8(uint8_t v) { *_p++ = v; }
+    void u16(uint16_t v) { le(v, 2); }
+    void u32(uint32_t v) { le(v, 4); }
+    void u64(uint64_t v) { le(v, 8); }
+    void str(std::string_view s)
+    {
+        u32(uint32_t(s.size()));
+        bytes(s.data(), s.size());
+    }
+    void bytes(const void *data, size_t len)
+    {
+        if (len > 0) {
+            std::memcpy(_p, data, len);
+            _p += len;
+        }
+    }
+    void record(uint8_t opcode, uint64_t len)
+    {
+        u8(opcode);
+        u64(len);
+    }
+
+   private:
+    void le(uint64_t v, int n)
+    {
+        for (int i = 0; i < n; i++) {
+            *_p++ = uint8_t(v >> (8 * i));
+        }
+    }
+
+    uint8_t *_p;
+};
+
+// Writes a single MCAP file. Not thread-safe: meant to be owned by an I/O thread.
+class McapWriter {
+   public:
+    McapWriter(const std::string &path, McapOptions options = {}) : _file(path), _options(options)
+    {
+        McapCursor c(file_reserve(MCAP_MAGIC_SIZE + MCAP_RECORD_PREFIX_SIZE + 8 + std::strlen(MCAP_PROFILE) +
+                                  std::strlen(MCAP_LIBRARY)));
+        c.bytes(MCAP_MAGIC, MCAP_MAGIC_SIZE);
+        c.record(MCAP_OP_HEADER, 8 + std::strlen(MCAP_PROFILE) + std::strlen(MCAP_LIBRARY));
+        c.str(MCAP_PROFILE);
+        c.str(MCAP_LIBRARY);
+    }
+
+    ~McapWriter()
+    {
+        try {
+            close();
+        } catch (const std::exception &e) {
+            std::cerr << "Failed to close the MCAP file: " << e.what() << std::endl;
+        }
+    }
+
+    McapWriter(const McapWriter &) = delete;
+    McapWriter &operator=(const McapWriter &) = delete;
+
+    // Register a schema, e.g. ("tf2_msgs/msg/TFMessage", "ros2msg", <definition>). Ids start at 1.
+    uint16_t add_schema(std::string name, std::string encoding, std::string data)
+    {
+        _schemas.push_back(Schema{uint16_t(_schemas.size() + 1), std::move(name), std::move(encoding), std::move(data)});
+        const auto &s = _schemas.back();
+        McapCursor c(chunk_reserve(schema_size(s)));
+        put_schema(c, s);
+        return s.id;
+    }
+
+    // Register a channel. `schema_id` 0 means that the messages have no schema.
+    uint16_t add_channel(uint16_t schema_id, std::string topic, std::string message_encoding,
+                         std::map<std::string, std::string> metadata = {})
+    {
+        if (_channels.size() >= std::numeric_limits<uint16_t>::max()) {
+            throw std::runtime_error("Too many MCAP channels");
+        }
+        _channels.push_back(
+            Channel{uint16_t(_channels.size()), schema_id, std::move(topic), std::move(message_encoding), std::move(metadata)});
+        _message_counts.push_back(0);
+        _message_index.emplace_back();
+        const auto &ch = _channels.back();
+        McapCursor c(chunk_reserve(channel_size(ch)));
+        put_channel(c, ch);
+        return ch.id;
+    }
+
+    // Append a message whose data is scattered in `slices`, e.g. the slices of a Zenoh payload
+    void write_message(uint16_t channel_id, uint64_t log_time, uint64_t publish_time, const ByteSpan *slices,
+                       size_t nb_slices)
+    {
+        size_t data_size = 0;
+        for (size_t i = 0; i < nb_slices; i++) {
+            data_size += slices[i].size;
+        }
+        size_t content_size = 2 + 4 + 8 + 8 + data_size;
+        McapCursor c(chunk_reserve(MCAP_RECORD_PREFIX_SIZE + content_size));
+        // Relative to the start of the records of the chunk, which may have just been opened
+        size_t offset = _chunk_records_size - (MCAP_RECORD_PREFIX_SIZE + content_size);
+        c.record(MCAP_OP_MESSAGE, content_size);
+        c.u16(channel_id);
+        c.u32(uint32_t(_message_counts[channel_id]));
+        c.u64(log_time);
+        c.u64(publish_time);
+        for (size_t i = 0; i < nb_slices; i++) {
+            c.bytes(slices[i].data, slices[i].size);
+        }
+
+        _message_counts[channel_id]++;
+        _message_count++;
+        _message_index[channel_id].emplace_back(log_time, offset);
+        _chunk_start_time = std::min(_chunk_start_time, log_time);
+        _chunk_end_time = std::max(_chunk_end_time, log_time);
+        if (_chunk_records_size >= _options.chunk_size) {
+            finish_chunk();
+        }
+    }
+
+    void write_message(uint16_t channel_id, uint64_t log_time, uint64_t publish_time, ByteSpan data)
+    {
+        write_message(channel_id, log_time, publish_time, &data, 1);
+    }
+
+    uint64_t message_count() const { return _message_count; }
+    size_t size() const { return _file_pos; }
+
+    // Write the summary and the footer. The writer can't be used afterwards.
+    // After a write error, the file is truncated after the last complete chunk, without a summary.
+    void close()
+    {
+        if (_closed) {
+            return;
+        }
+        if (_failed) {
+            // Only the records completed before the error are kept, without a summary
+            _closed = true;
+            _file.close(_file_pos);
+            return;
+        }
+        finish_chunk();
+
+        McapCursor data_end(file_reserve(MCAP_RECORD_PREFIX_SIZE + 4));
+        data_end.record(MCAP_OP_DATA_END, 4);
+        data_end.u32(0);  // The CRC is optional
+
+        uint64_t summary_start = _file_pos;
+        for (const auto &s : _schemas) {
+            McapCursor c(file_reserve(schema_size(s)));
+            put_schema(c, s);
+        }
+        for (const auto &ch : _channels) {
+            McapCursor c(file_reserve(channel_size(ch)));
+            put_channel(c, ch);
+        }
+        write_statistics();
+        for (const auto &ci : _chunk_indexes) {
+            write_chunk_index(ci);
+        }
+
+        McapCursor footer(file_reserve(MCAP_RECORD_PREFIX_SIZE + 8 + 8 + 4 + MCAP_MAGIC_SIZE));
+        footer.record(MCAP_OP_FOOTER, 8 + 8 + 4);
+        footer.u64(summary_start);
+        footer.u64(0);  // No summary offsets
+        footer.u32(0);  // The CRC is optional
+        footer.bytes(MCAP_MAGIC, MCAP_MAGIC_SIZE);
+        _closed = true;
+        _file.close(_file_pos);
+    }
+
+   private:
+    struct Schema {
+        uint16_t id;
+        std::string name;
+        std::string encoding;
+        std::string data;
+    };
+
+    struct Channel {
+        uint16_t id;
+        uint16_t schema_id;
+        std::string topic;
+        std::string message_encoding;
+        std::map<std::string, std::string> metadata;
+    };
+
+    struct ChunkIndex {
+        uint64_t start_time;
+        uint64_t end_time;
+        uint64_t offset;
+        uint64_t length;
+        std::vector<std::pair<uint16_t, uint64_t>> message_index_offsets;
+        uint64_t message_index_length;
+        uint64_t compressed_size;
+        uint64_t uncompressed_size;
+    };
+
+    // The chunk fields before the records: start/end times, uncompressed size, CRC, compression, records size
+    size_t chunk_header_size() const
+    {
+        return MCAP_RECORD_PREFIX_SIZE + 8 + 8 + 8 + 4 + 4 + std::strlen(to_string(_options.compression)) + 8;
+    }
+
+    static size_t schema_size(const Schema &s)
+    {
+        return MCAP_RECORD_PREFIX_SIZE + 2 + 4 + s.name.size() + 4 + s.encoding.size() + 4 + s.data.size();
+    }
+
+    static void put_schema(McapCursor &c, const Schema &s)
+    {
+        c.record(MCAP_OP_SCHEMA, schema_size(s) - MCAP_RECORD_PREFIX_SIZE);
+        c.u16(s.id);
+        c.str(s.name);
+        c.str(s.encoding);
+        c.str(s.data);
+    }
+
+    static size_t metadata_size(const std::map<std::string, std::string> &metadata)
+    {
+        size_t size = 0;
+        for (const auto &[k, v] : metadata) {
+            size += 4 + k.size() + 4 + v.size();
+        }
+        return size;
+    }
+
+    static size_t channel_size(const Channel &ch)
+    {
+        return MCAP_RECORD_PREFIX_SIZE + 2 + 2 + 4 + ch.topic.size() + 4 + ch.message_encoding.size() + 4 +
+               metadata_size(ch.metadata);
+    }
+
+    static void put_channel(McapCursor &c, const Channel &ch)
+    {
+        c.record(MCAP_OP_CHANNEL, channel_size(ch) - MCAP_RECORD_PREFIX_SIZE);
+        c.u16(ch.id);
+        c.u16(ch.schema_id);
+        c.str(ch.topic);
+        c.str(ch.message_encoding);
+        c.u32(uint32_t(metadata_size(ch.metadata)));
+        for (const auto &[k, v] : ch.metadata) {
+            c.str(k);
+            c.str(v);
+        }
+    }
+
+    // Once the file failed to grow, nothing more is written to it
+    uint8_t *file_reserve(size_t len)
+    {
+        if (_failed) {
+            throw std::runtime_error("The MCAP file can't be written after a previous error");
+        }
+        uint8_t *p;
+        try {
+            p = _file.at(_file_pos, len);
+        } catch (...) {
+            fail();
+            throw;
+        }
+        _file_pos += len;
+        return p;
+    }
+
+    // Space for `len` bytes of records in the current chunk, opening one if needed.
+    // Uncompressed records go straight to the file, compressed ones to the chunk buffer.
+    uint8_t *chunk_reserve(size_t len)
+    {
+        if (_failed) {
+            throw std::runtime_error("The MCAP file can't be written after a previous error");
+        }
+        if (!_chunk_open) {
+            _chunk_open = true;
+            _chunk_offset = _file_pos;
+            _chunk_records_size = 0;
+            _chunk_start_time = std::numeric_limits<uint64_t>::max();
+            _chunk_end_time = 0;
+            if (_options.compression == McapCompression::None) {
+                // The header is filled in when the chunk is finished
+                file_reserve(chunk_header_size());
+            }
+        }
+        uint8_t *p;
+        if (_options.compression == McapCompression::None) {
+            p = file_reserve(len);
+        } else {
+            if (_chunk_records_size + len > _chunk_buffer_capacity) {
+                size_t capacity = std::max(_chunk_records_size + len, _options.chunk_size + _options.chunk_size / 4);
+                std::unique_ptr<uint8_t[]> buffer(new uint8_t[capacity]);
+                if (_chunk_records_size > 0) {
+                    std::memcpy(buffer.get(), _chunk_buffer.get(), _chunk_records_size);
+                }
+                _chunk_buffer = std::move(buffer);
+                _chunk_buffer_capacity = capacity;
+            }
+            p = _chunk_buffer.get() + _chunk_records_size;
+        }
+        _chunk_records_size += len;
+        return p;
+    }
+
+    // Drop the chunk being written: the file is truncated before it when closed
+    void fail()
+    {
+        if (_chunk_open) {
+            _chunk_open = false;
+            _file_pos = _chunk_offset;
+        }
+        _failed = true;
+    }
+
+    void finish_chunk()
+    {
+        if (!_chunk_open) {
+            return;
+        }
+        try {
+            write_chunk();
+        } catch (...) {
+            fail();
+            throw;
+        }
+        _chunk_open = false;
+    }
+
+    // The chunk is still open while it's written, so that a failure drops it
+    void write_chunk()
+    {
+        if (_chunk_start_time > _chunk_end_time) {
+            // Only schemas and channels
+            _chunk_start_time = 0;
+        }
+
+        uint64_t compressed_size = _chunk_records_size;
+        if (_options.compression != McapCompression::None) {
+            // Compress straight into the file, after the space of the chunk header
+            compressed_size = compress_chunk();
+        }
+        McapCursor c(_file.at(_chunk_offset, chunk_header_size()));
+        c.record(MCAP_OP_CHUNK, chunk_header_size() - MCAP_RECORD_PREFIX_SIZE + compressed_size);
+        c.u64(_chunk_start_time);
+        c.u64(_chunk_end_time);
+        c.u64(_chunk_records_size);
+        c.u32(0);  // The CRC is optional
+        c.str(to_string(_options.compression));
+        c.u64(compressed_size);
+
+        ChunkIndex ci;
+        ci.start_time = _chunk_start_time;
+        ci.end_time = _chunk_end_time;
+        ci.offset = _chunk_offset;
+        ci.length = _file_pos - _chunk_offset;
+        ci.compressed_size = compressed_size;
+        ci.uncompressed_size = _chunk_records_size;
+
+        // The message indexes of the chunk follow it
+        uint64_t index_start = _file_pos;
+        for (uint16_t id = 0; id < _message_index.size(); id++) {
+            auto &entries = _message_index[id];
+            if (entries.empty()) {
+                continue;
+            }
+            ci.message_index_offsets.emplace_back(id, _file_pos);
+            size_t content_size = 2 + 4 + entries.size() * 16;
+            McapCursor mi(file_reserve(MCAP_RECORD_PREFIX_SIZE + content_size));
+            mi.record(MCAP_OP_MESSAGE_INDEX, content_size);
+            mi.u16(id);
+            mi.u32(uint32_t(entries.size() * 16));
+            for (const auto &[time, offset] : entries) {
+                mi.u64(time);
+                mi.u64(offset);
+            }
+            // Keep the capacity for the next chunk
+            entries.clear();
+        }
+        ci.message_index_length = _file_pos - index_start;
+        _chunk_indexes.push_back(std::move(ci));
+    }
+
+    uint64_t compress_chunk()
+    {
+#ifdef ZENOH_ROS_WITH_ZSTD
+        if (_zstd == nullptr) {
+            _zstd.reset(ZSTD_createCCtx());
+        }
+        size_t bound = ZSTD_compressBound(_chunk_records_size);
+        uint8_t *dst = _file.at(_chunk_offset + chunk_header_size(), bound);
+        size_t size = ZSTD_compressCCtx(_zstd.get(), dst, bound, _chunk_buffer.get(), _chunk_records_size, 1);
+        if (ZSTD_isError(size)) {
+            throw std::runtime_error(std::string("Failed to compress an MCAP chunk: ") + ZSTD_getErrorName(size));
+        }
+        _file_pos = _chunk_offset + chunk_header_size() + size;
+        return size;
+#else
+        throw std::runtime_error("MCAP compression is not available");
+#endif
+    }
+
+    void write_statistics()
+    {
+        size_t counts_size = _channels.size() * (2 + 8);
+        size_t content_size = 8 + 2 + 4 + 4 + 4 + 4 + 8 + 8 + 4 + counts_size;
+        uint64_t start_time = std::numeric_limits<uint64_t>::max();
+        uint64_t end_time = 0;
+        for (const auto &ci : _chunk_indexes) {
+            if (ci.end_time != 0) {
+                start_time = std::min(start_time, ci.start_time);
+                end_time = std::max(end_time, ci.end_time);
+            }
+        }
+        McapCursor c(file_reserve(MCAP_RECORD_PREFIX_SIZE + content_size));
+        c.record(MCAP_OP_STATISTICS, content_size);
+        c.u64(_message_count);
+        c.u16(uint16_t(_schemas.size()));
+        c.u32(uint32_t(_channels.size()));
+        c.u32(0);  // Attachments
+        c.u32(0);  // Metadata
+        c.u32(uint32_t(_chunk_indexes.size()));
+        c.u64(end_time != 0 ? start_time : 0);
+        c.u64(end_time);
+        c.u32(uint32_t(counts_size));
+        for (const auto &ch : _channels) {
+            c.u16(ch.id);
+            c.u64(_message_counts[ch.id]);
+        }
+    }
+
+    void write_chunk_index(const ChunkIndex &ci)
+    {
+        const char *compression = to_string(_options.compression);
+        size_t offsets_size = ci.message_index_offsets.size() * (2 + 8);
+        size_t content_size = 8 + 8 + 8 + 8 + 4 + offsets_size + 8 + 4 + std::strlen(compression) + 8 + 8;
+        McapCursor c(file_reserve(MCAP_RECORD_PREFIX_SIZE + content_size));
+        c.record(MCAP_OP_CHUNK_INDEX, content_size);
+        c.u64(ci.start_time);
+        c.u64(ci.end_time);
+        c.u64(ci.offset);
+        c.u64(ci.length);
+        c.u32(uint32_t(offsets_size));
+        for (const auto &[id, offset] : ci.message_index_offsets) {
+            c.u16(id);
+            c.u64(offset);
+        }
+        c.u64(ci.message_index_length);
+        c.str(compression);
+        c.u64(ci.compressed_size);
+        c.u64(ci.uncompressed_size);
+    }
+
+    MappedFile _file;
+    McapOptions _options;
+    size_t _file_pos = 0;
+    bool _closed = false;
+    bool _failed = false;
+
+    std::vector<Schema> _schemas;
+    std::vector<Channel> _channels;
+    std::vector<uint64_t> _message_counts;
+    uint64_t _message_count = 0;
+
+    // The current chunk
+    bool _chunk_open = false;
+    uint64_t _chunk_offset = 0;
+    size_t _chunk_records_size = 0;
+    uint64_t _chunk_start_time = 0;
+    uint64_t _chunk_end_time = 0;
+    std::unique_ptr<uint8_t[]> _chunk_buffer;
+    size_t _chunk_buffer_capacity = 0;
+    // Per channel, the log time and the offset in the chunk of each message
+    std::vector<std::vector<std::pair<uint64_t, uint64_t>>> _message_index;
+
+    std::vector<ChunkIndex> _chunk_indexes;
+
+#ifdef ZENOH_ROS_WITH_ZSTD
+    struct ZstdDeleter {
+        void operator()(ZSTD_CCtx *ctx) const { ZSTD_freeCCtx(ctx); }
+    };
+    std::unique_ptr<ZSTD_CCtx, ZstdDeleter> _zstd;
+#endif
+};
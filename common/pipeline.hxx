@@ -0,0 +1,271 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// A bounded multi-producer/multi-consumer ring buffer.
+// This is Dmitry Vyukov's algorithm: each cell carries a sequence number that
+// tells producers and consumers whether it's theirs to use, so neither side
+// takes a lock. The capacity doesn't need to be a power of two, which lets us
+// honour the exact history depth of a topic.
+template <typename T>
+class BoundedQueue {
+   public:
+    explicit BoundedQueue(size_t capacity) : _capacity(capacity), _cells(new Cell[capacity])
+    {
+        if (capacity == 0) {
+            throw std::runtime_error("BoundedQueue capacity must be greater than 0");
+        }
+        for (size_t i = 0; i < capacity; i++) {
+            _cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue &) = delete;
+    BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+    // Returns false, leaving `value` untouched, if the queue is full
+    bool try_push(T &value)
+    {
+        size_t pos = _tail.load(std::memory_order_relaxed);
+        while (true) {
+            Cell &cell = _cells[pos % _capacity];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t diff = intptr_t(seq) - intptr_t(pos);
+            if (diff == 0) {
+                if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value.emplace(std::move(value));
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = _tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::optional<T> try_pop()
+    {
+        size_t pos = _head.load(std::memory_order_relaxed);
+        while (true) {
+            Cell &cell = _cells[pos % _capacity];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t diff = intptr_t(seq) - intptr_t(pos + 1);
+            if (diff == 0) {
+                if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    std::optional<T> value(std::move(cell.value));
+                    cell.value.reset();
+                    cell.seq.store(pos + _capacity, std::memory_order_release);
+                    return value;
+                }
+            } else if (diff < 0) {
+                return std::nullopt;
+            } else {
+                pos = _head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Only a hint while producers and consumers are running
+    bool empty() const
+    {
+        return _head.load(std::memory_order_acquire) >= _tail.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return _capacity; }
+
+   private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        std::optional<T> value;
+    };
+
+    const size_t _capacity;
+    std::unique_ptr<Cell[]> _cells;
+    // Keep producers and consumers on separate cache lines
+    alignas(64) std::atomic<size_t> _tail{0};
+    alignas(64) std::atomic<size_t> _head{0};
+};
+
+// The QoS history of a topic, as encoded in rmw_zenoh liveliness tokens:
+//   "<reliability>:<durability>:<history_kind>,<history_depth>:<deadline>:<lifespan>:<liveliness>"
+// e.g. "::,5:,:,:,," is a volatile topic keeping the last 5 samples.
+// https://github.com/ros2/rmw_zenoh/blob/rolling/docs/design.md#graph-cache
+struct QosHistory {
+    bool keep_all = false;
+    bool transient_local = false;
+    size_t depth = 0;
+};
+
+inline QosHistory parse_qos_history(std::string_view qos, size_t default_depth)
+{
+    QosHistory history;
+    history.depth = default_depth;
+
+    std::vector<std::string_view> parts;
+    size_t start = 0;
+    for (size_t pos = qos.find(':'); pos != std::string_view::npos; pos = qos.find(':', start)) {
+        parts.push_back(qos.substr(start, pos - start));
+        start = pos + 1;
+    }
+    parts.push_back(qos.substr(start));
+
+    // Durability: 1 is TRANSIENT_LOCAL in rmw_qos_durability_policy_e
+    if (parts.size() > 1) {
+        history.transient_local = parts[1] == "1";
+    }
+    // History: 2 is KEEP_ALL in rmw_qos_history_policy_e, anything else keeps the last <depth> samples
+    if (parts.size() > 2) {
+        auto history_part = parts[2];
+        auto comma = history_part.find(',');
+        auto kind = history_part.substr(0, comma);
+        history.keep_all = kind == "2";
+        if (comma != std::string_view::npos && comma + 1 < history_part.size()) {
+            auto depth = std::strtoul(std::string(history_part.substr(comma + 1)).c_str(), nullptr, 10);
+            if (depth > 0) {
+                history.depth = depth;
+            }
+        }
+    }
+    return history;
+}
+
+// What to do when a sample arrives while the queue is full
+enum class OverflowPolicy {
+    DropOldest,  // KEEP_LAST semantics: the new sample evicts the oldest one
+    DropNewest,  // the new sample is discarded, the queued ones are kept
+};
+
+inline OverflowPolicy overflow_policy_for(const QosHistory &history)
+{
+    return history.keep_all ? OverflowPolicy::DropNewest : OverflowPolicy::DropOldest;
+}
+
+// A pipeline stage decoupling the Zenoh callbacks from the processing.
+// The callback only moves the item into a bounded queue, which is drained by a
+// pool of worker threads running the handler. With more than one worker,
+// items of the same topic may be processed out of order.
+template <typename T>
+class Pipeline {
+   public:
+    using Handler = std::function<void(T &)>;
+
+    Pipeline(std::string name, size_t depth, OverflowPolicy policy, size_t nb_workers, Handler handler)
+        : _name(std::move(name)), _queue(depth), _policy(policy), _handler(std::move(handler))
+    {
+        if (nb_workers == 0) {
+            throw std::runtime_error("Pipeline '" + _name + "' needs at least one worker");
+        }
+        for (size_t i = 0; i < nb_workers; i++) {
+            _workers.emplace_back([this]() { run(); });
+        }
+    }
+
+    Pipeline(const Pipeline &) = delete;
+    Pipeline &operator=(const Pipeline &) = delete;
+
+    ~Pipeline()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop.store(true);
+        }
+        _cv.notify_all();
+        for (auto &w : _workers) {
+            w.join();
+        }
+    }
+
+    // Called from the Zenoh callback: never blocks on the handler. False if the item itself was dropped.
+    bool push(T &&item)
+    {
+        while (!_queue.try_push(item)) {
+            if (_policy == OverflowPolicy::DropNewest) {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            if (_queue.try_pop().has_value()) {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        _pushed.fetch_add(1, std::memory_order_relaxed);
+        // Paired with the fence in run(): either we see the sleeper, or it sees the item.
+        // The tail is published with a relaxed CAS, only a full fence orders it before the load of the sleepers.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_sleepers.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _cv.notify_one();
+        }
+        return true;
+    }
+
+    const std::string &name() const { return _name; }
+    size_t depth() const { return _queue.capacity(); }
+    uint64_t pushed() const { return _pushed.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+   private:
+    void run()
+    {
+        while (true) {
+            if (auto item = _queue.try_pop()) {
+                try {
+                    _handler(*item);
+                } catch (const std::exception &e) {
+                    std::cerr << "[" << _name << "] Handler failed: " << e.what() << std::endl;
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(_mutex);
+            _sleepers.fetch_add(1);
+            // Order the registration as a sleeper before the check of the tail in empty()
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            _cv.wait(lock, [this]() { return _stop.load() || !_queue.empty(); });
+            _sleepers.fetch_sub(1);
+            if (_stop.load() && _queue.empty()) {
+                return;
+            }
+        }
+    }
+
+    std::string _name;
+    BoundedQueue<T> _queue;
+    OverflowPolicy _policy;
+    Handler _handler;
+    std::vector<std::thread> _workers;
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::atomic<size_t> _sleepers{0};
+    std::atomic<bool> _stop{false};
+
+    std::atomic<uint64_t> _pushed{0};
+    std::atomic<uint64_t> _dropped{0};
+};
@@ -0,0 +1,411 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "cdr_view.hxx"
+#include "point_cloud_fields.hxx"
+#include "point_cloud_view.hxx"
+#include "voxel_grid.hxx"
+
+// A compact encoding of point clouds for constrained links. The points are
+// decimated (every Nth point, and/or the first point of each voxel), their
+// x/y/z (and intensity) are quantized to 16 bits relative to the bounding box
+// of the frame, and each channel is delta-coded from one point to the next,
+// zigzag-mapped and written as a varint: neighbouring points of a scan mostly
+// take 1 or 2 bytes per channel instead of 4.
+//
+// The cloud is processed in chunks of points, so that only a chunk is ever
+// unpacked at once, and each chunk can be decoded on its own. All the values
+// are little endian:
+//
+//   header: magic "ZPC1" | u8 version | u8 flags | u16 frame_id length
+//           | i32 stamp sec | u32 stamp nanosec | u32 nb_points | u32 nb_chunks
+//           | f32 origin[4] | f32 scale[4] | frame_id
+//   chunk:  u32 nb_points | u32 nb_bytes | varints (x, y, z[, intensity] of each point)
+//
+// A channel is decoded as origin + q * scale, with q in [0, 65535]: the error
+// is about half the scale, i.e. the size of the bounding box / 131070.
+
+#define POINT_CLOUD_CODEC_MAGIC "ZPC1"
+#define POINT_CLOUD_CODEC_VERSION 1
+#define POINT_CLOUD_CODEC_HEADER_SIZE 56
+#define POINT_CLOUD_CODEC_CHUNK_HEADER_SIZE 8
+// The number of points unpacked and encoded at once
+#define POINT_CLOUD_CODEC_CHUNK_POINTS 4096
+#define POINT_CLOUD_CODEC_LEVELS 65535
+// Flags
+#define POINT_CLOUD_CODEC_HAS_INTENSITY 0x01
+
+struct PointCloudCodecOptions {
+    // The side of the voxels keeping a single point, 0 to keep them all
+    float voxel_size = 0;
+    // Keep one point out of `stride`
+    size_t stride = 1;
+    size_t chunk_points = POINT_CLOUD_CODEC_CHUNK_POINTS;
+    // Drop the intensity even if the cloud has one
+    bool drop_intensity = false;
+};
+
+namespace point_cloud_codec_detail {
+
+inline void put_u16(std::vector<uint8_t> &out, size_t pos, uint16_t v)
+{
+    out[pos] = uint8_t(v);
+    out[pos + 1] = uint8_t(v >> 8);
+}
+
+inline void put_u32(std::vector<uint8_t> &out, size_t pos, uint32_t v)
+{
+    for (size_t i = 0; i < 4; i++) {
+        out[pos + i] = uint8_t(v >> (8 * i));
+    }
+}
+
+inline void put_f32(std::vector<uint8_t> &out, size_t pos, float v)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    put_u32(out, pos, bits);
+}
+
+inline uint16_t get_u16(const uint8_t *p) { return uint16_t(p[0] | (p[1] << 8)); }
+
+inline uint32_t get_u32(const uint8_t *p)
+{
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+inline float get_f32(const uint8_t *p)
+{
+    uint32_t bits = get_u32(p);
+    float v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+// Small differences, positive or negative, map to small unsigned values: 0, -1, 1, -2... -> 0, 1, 2, 3...
+inline uint32_t zigzag_encode(int32_t v) { return (uint32_t(v) << 1) ^ uint32_t(v >> 31); }
+inline int32_t zigzag_decode(uint32_t v) { return int32_t(v >> 1) ^ -int32_t(v & 1); }
+
+// A quantized delta fits in 17 bits: at most 3 bytes
+inline uint8_t *put_varint(uint8_t *p, uint32_t v)
+{
+    while (v >= 0x80) {
+        *p++ = uint8_t(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = uint8_t(v);
+    return p;
+}
+
+inline const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint32_t &v)
+{
+    v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (p == end) {
+            throw std::runtime_error("Truncated point cloud chunk");
+        }
+        uint8_t b = *p++;
+        v |= uint32_t(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) {
+            return p;
+        }
+    }
+    throw std::runtime_error("Invalid varint in point cloud chunk");
+}
+
+}  // namespace point_cloud_codec_detail
+
+// Encodes PointCloud2 messages into compressed frames.
+// Keep one encoder per thread: its buffers are reused from one cloud to the next.
+class PointCloudEncoder {
+   public:
+    explicit PointCloudEncoder(PointCloudCodecOptions options = {}) : _options(options)
+    {
+        if (_options.stride == 0) {
+            _options.stride = 1;
+        }
+        if (_options.chunk_points == 0) {
+            _options.chunk_points = POINT_CLOUD_CODEC_CHUNK_POINTS;
+        }
+        _inv_leaf = _options.voxel_size > 0 ? 1.0f / _options.voxel_size : 0.0f;
+    }
+
+    // Encode `cloud` into `out`, replacing its content.
+    // Returns false if the cloud has no usable x/y/z fields.
+    bool encode(const PointCloud2View &cloud, std::vector<uint8_t> &out)
+    {
+        using namespace point_cloud_codec_detail;
+
+        const auto &layout = _layouts.get(cloud);
+        if (!layout.has_value()) {
+            return false;
+        }
+        const bool with_intensity = layout->has_intensity && !_options.drop_intensity;
+        const size_t nb_channels = with_intensity ? CHANNEL_COUNT : CHANNEL_INTENSITY;
+        const size_t n = cloud.point_count();
+
+        // First pass: the bounding box of the frame, chunk by chunk
+        std::array<float, CHANNEL_COUNT> min, max;
+        min.fill(INFINITY);
+        max.fill(-INFINITY);
+        for (size_t begin = 0; begin < n; begin += _options.chunk_points) {
+            unpack_points(cloud, *layout, begin, begin + _options.chunk_points, _chunk);
+            for (size_t i = 0; i < _chunk.size(); i++) {
+                if (!std::isfinite(_chunk.x[i]) || !std::isfinite(_chunk.y[i]) || !std::isfinite(_chunk.z[i])) {
+                    continue;
+                }
+                for (size_t c = 0; c < nb_channels; c++) {
+                    float v = _chunk.channel(c)[i];
+                    // e.g. a NaN intensity: quantized as the origin of the channel
+                    if (!std::isfinite(v)) {
+                        continue;
+                    }
+                    min[c] = std::min(min[c], v);
+                    max[c] = std::max(max[c], v);
+                }
+            }
+        }
+        std::array<float, CHANNEL_COUNT> origin{}, scale{}, inv_scale{};
+        for (size_t c = 0; c < nb_channels; c++) {
+            if (min[c] <= max[c]) {
+                origin[c] = min[c];
+                scale[c] = (max[c] - min[c]) / POINT_CLOUD_CODEC_LEVELS;
+                if (!std::isfinite(scale[c])) {
+                    // The extent overflows a float
+                    scale[c] = max[c] / POINT_CLOUD_CODEC_LEVELS - min[c] / POINT_CLOUD_CODEC_LEVELS;
+                }
+            }
+            inv_scale[c] = scale[c] > 0 ? 1.0f / scale[c] : 0.0f;
+        }
+
+        // The header, whose counts are patched at the end
+        std::string_view frame_id = cloud.header().frame_id.substr(0, UINT16_MAX);
+        out.resize(POINT_CLOUD_CODEC_HEADER_SIZE + frame_id.size());
+        std::memcpy(out.data(), POINT_CLOUD_CODEC_MAGIC, 4);
+        out[4] = POINT_CLOUD_CODEC_VERSION;
+        out[5] = with_intensity ? POINT_CLOUD_CODEC_HAS_INTENSITY : 0;
+        put_u16(out, 6, uint16_t(frame_id.size()));
+        put_u32(out, 8, uint32_t(cloud.header().stamp.sec));
+        put_u32(out, 12, cloud.header().stamp.nanosec);
+        for (size_t c = 0; c < CHANNEL_COUNT; c++) {
+            put_f32(out, 24 + 4 * c, origin[c]);
+            put_f32(out, 40 + 4 * c, scale[c]);
+        }
+        std::memcpy(out.data() + POINT_CLOUD_CODEC_HEADER_SIZE, frame_id.data(), frame_id.size());
+
+        // Second pass: decimate, quantize and encode each chunk
+        _voxels.clear();
+        uint32_t nb_points = 0;
+        uint32_t nb_chunks = 0;
+        for (size_t begin = 0; begin < n; begin += _options.chunk_points) {
+            unpack_points(cloud, *layout, begin, begin + _options.chunk_points, _chunk);
+
+            size_t chunk_pos = out.size();
+            // Room for the worst case, 3 bytes per channel, trimmed afterwards
+            out.resize(chunk_pos + POINT_CLOUD_CODEC_CHUNK_HEADER_SIZE + _chunk.size() * nb_channels * 3);
+            uint8_t *p = out.data() + chunk_pos + POINT_CLOUD_CODEC_CHUNK_HEADER_SIZE;
+            std::array<int32_t, CHANNEL_COUNT> prev{};
+            uint32_t chunk_points = 0;
+            for (size_t i = 0; i < _chunk.size(); i++) {
+                if (!keep(begin + i, _chunk.x[i], _chunk.y[i], _chunk.z[i])) {
+                    continue;
+                }
+                for (size_t c = 0; c < nb_channels; c++) {
+                    float q = std::nearbyint((_chunk.channel(c)[i] - origin[c]) * inv_scale[c]);
+                    // Casting a NaN is undefined, and the varint of anything outside the levels overflows the room
+                    int32_t v = std::isnan(q) ? 0 : int32_t(std::clamp(q, 0.0f, float(POINT_CLOUD_CODEC_LEVELS)));
+                    p = put_varint(p, zigzag_encode(v - prev[c]));
+                    prev[c] = v;
+                }
+                chunk_points++;
+            }
+            if (chunk_points == 0) {
+                out.resize(chunk_pos);
+                continue;
+            }
+            size_t chunk_end = size_t(p - out.data());
+            put_u32(out, chunk_pos, chunk_points);
+            put_u32(out, chunk_pos + 4, uint32_t(chunk_end - chunk_pos - POINT_CLOUD_CODEC_CHUNK_HEADER_SIZE));
+            out.resize(chunk_end);
+            nb_points += chunk_points;
+            nb_chunks++;
+        }
+        put_u32(out, 16, nb_points);
+        put_u32(out, 20, nb_chunks);
+        _nb_points = nb_points;
+        return true;
+    }
+
+    // The number of points kept in the last encoded cloud
+    size_t nb_points() const { return _nb_points; }
+
+   private:
+    // Whether the point of index `i` in the cloud survives the decimation
+    bool keep(size_t i, float x, float y, float z)
+    {
+        if (!std::isfinite(x) || !std::isfinite(y) || !std::isfinite(z)) {
+            return false;
+        }
+        if (_options.stride > 1 && i % _options.stride != 0) {
+            return false;
+        }
+        if (_options.voxel_size > 0) {
+            // The first point of each voxel stands for it: unlike a centroid, it needs no second pass
+            uint64_t key;
+            if (!pack_voxel_key(x, y, z, _inv_leaf, key) || !_voxels.insert(key).second) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    PointCloudCodecOptions _options;
+    float _inv_leaf;
+    PointLayoutCache _layouts;
+    // Only a chunk of the cloud is unpacked at once
+    PointCloudSoA _chunk;
+    // The voxels already taken in the current cloud, the buckets are reused
+    std::unordered_set<uint64_t> _voxels;
+    size_t _nb_points = 0;
+};
+
+struct CompressedPointCloudHeader {
+    TimeView stamp;
+    std::string_view frame_id;
+    uint32_t nb_points = 0;
+    uint32_t nb_chunks = 0;
+    bool has_intensity = false;
+    std::array<float, CHANNEL_COUNT> origin{};
+    std::array<float, CHANNEL_COUNT> scale{};
+};
+
+// Decodes a frame of PointCloudEncoder, chunk by chunk.
+// The frame must outlive the decoder, the frame ID is a view into it.
+class PointCloudDecoder {
+   public:
+    PointCloudDecoder(const uint8_t *data, size_t len) : _pos(data), _end(data + len)
+    {
+        using namespace point_cloud_codec_detail;
+
+        if (len < POINT_CLOUD_CODEC_HEADER_SIZE || std::memcmp(data, POINT_CLOUD_CODEC_MAGIC, 4) != 0) {
+            throw std::runtime_error("Not a compressed point cloud");
+        }
+        if (data[4] != POINT_CLOUD_CODEC_VERSION) {
+            throw std::runtime_error("Unsupported compressed point cloud version " + std::to_string(data[4]));
+        }
+        _header.has_intensity = (data[5] & POINT_CLOUD_CODEC_HAS_INTENSITY) != 0;
+        size_t frame_id_len = get_u16(data + 6);
+        _header.stamp.sec = int32_t(get_u32(data + 8));
+        _header.stamp.nanosec = get_u32(data + 12);
+        _header.nb_points = get_u32(data + 16);
+        _header.nb_chunks = get_u32(data + 20);
+        for (size_t c = 0; c < CHANNEL_COUNT; c++) {
+            _header.origin[c] = get_f32(data + 24 + 4 * c);
+            _header.scale[c] = get_f32(data + 40 + 4 * c);
+        }
+        if (len - POINT_CLOUD_CODEC_HEADER_SIZE < frame_id_len) {
+            throw std::runtime_error("Truncated compressed point cloud header");
+        }
+        _header.frame_id =
+            std::string_view(reinterpret_cast<const char *>(data + POINT_CLOUD_CODEC_HEADER_SIZE), frame_id_len);
+        _pos = data + POINT_CLOUD_CODEC_HEADER_SIZE + frame_id_len;
+    }
+
+    explicit PointCloudDecoder(ByteSpan frame) : PointCloudDecoder(frame.data, frame.size) {}
+
+    const CompressedPointCloudHeader &header() const { return _header; }
+
+    // Decode the next chunk into `out`, whose buffers are reused. Returns false after the last chunk.
+    bool next_chunk(PointCloudSoA &out)
+    {
+        using namespace point_cloud_codec_detail;
+
+        if (_nb_decoded == _header.nb_chunks) {
+            return false;
+        }
+        if (size_t(_end - _pos) < POINT_CLOUD_CODEC_CHUNK_HEADER_SIZE) {
+            throw std::runtime_error("Truncated compressed point cloud");
+        }
+        uint32_t nb_points = get_u32(_pos);
+        uint32_t nb_bytes = get_u32(_pos + 4);
+        _pos += POINT_CLOUD_CODEC_CHUNK_HEADER_SIZE;
+        if (size_t(_end - _pos) < nb_bytes) {
+            throw std::runtime_error("Truncated compressed point cloud chunk");
+        }
+        const uint8_t *p = _pos;
+        const uint8_t *chunk_end = _pos + nb_bytes;
+        // Each point takes at least a byte per channel
+        const size_t nb_channels = _header.has_intensity ? CHANNEL_COUNT : CHANNEL_INTENSITY;
+        if (size_t(nb_points) * nb_channels > nb_bytes) {
+            throw std::runtime_error("Invalid compressed point cloud chunk");
+        }
+
+        out.resize(nb_points, _header.has_intensity);
+        std::array<int32_t, CHANNEL_COUNT> prev{};
+        for (uint32_t i = 0; i < nb_points; i++) {
+            for (size_t c = 0; c < nb_channels; c++) {
+                uint32_t v;
+                p = get_varint(p, chunk_end, v);
+                int64_t q = int64_t(prev[c]) + zigzag_decode(v);
+                if (q < 0 || q > POINT_CLOUD_CODEC_LEVELS) {
+                    throw std::runtime_error("Invalid quantized value in point cloud chunk");
+                }
+                prev[c] = int32_t(q);
+                out.channel(c)[i] = _header.origin[c] + float(prev[c]) * _header.scale[c];
+            }
+        }
+        _pos = chunk_end;
+        _nb_decoded++;
+        return true;
+    }
+
+    // Decode all the remaining points into `out`
+    void decode_all(PointCloudSoA &out)
+    {
+        const size_t nb_channels = _header.has_intensity ? CHANNEL_COUNT : CHANNEL_INTENSITY;
+        // The header is not trusted: each point takes at least a byte per channel
+        size_t capacity = std::min(size_t(_header.nb_points), size_t(_end - _pos) / nb_channels);
+        out.resize(0, _header.has_intensity);
+        out.x.reserve(capacity);
+        out.y.reserve(capacity);
+        out.z.reserve(capacity);
+        if (_header.has_intensity) {
+            out.intensity.reserve(capacity);
+        }
+        while (next_chunk(_chunk)) {
+            for (size_t c = 0; c < nb_channels; c++) {
+                auto &dst = c == CHANNEL_X ? out.x : c == CHANNEL_Y ? out.y : c == CHANNEL_Z ? out.z : out.intensity;
+                dst.insert(dst.end(), _chunk.channel(c), _chunk.channel(c) + _chunk.size());
+            }
+        }
+    }
+
+   private:
+    CompressedPointCloudHeader _header;
+    const uint8_t *_pos;
+    const uint8_t *_end;
+    uint32_t _nb_decoded = 0;
+    PointCloudSoA _chunk;
+};
@@ -0,0 +1,433 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define POINT_CLOUD_X86_SIMD 1
+#endif
+
+#include "point_cloud_view.hxx"
+
+// Extraction of the x/y/z/intensity fields of a PointCloud2 into contiguous
+// arrays (SoA), so that downstream processing doesn't have to deal with the
+// interleaved `point_step` layout, the field datatypes or the endianness.
+
+// The datatypes of sensor_msgs/msg/PointField (see common/idl/PointField.idl)
+#define POINT_FIELD_INT8    1
+#define POINT_FIELD_UINT8   2
+#define POINT_FIELD_INT16   3
+#define POINT_FIELD_UINT16  4
+#define POINT_FIELD_INT32   5
+#define POINT_FIELD_UINT32  6
+#define POINT_FIELD_FLOAT32 7
+#define POINT_FIELD_FLOAT64 8
+
+enum PointChannel { CHANNEL_X = 0, CHANNEL_Y, CHANNEL_Z, CHANNEL_INTENSITY, CHANNEL_COUNT };
+
+// Where each channel lives inside a point
+struct PointLayout {
+    uint32_t point_step = 0;
+    std::array<uint32_t, CHANNEL_COUNT> offset{};
+    std::array<uint8_t, CHANNEL_COUNT> datatype{};
+    bool has_intensity = false;
+    // Whether the points are stored with the opposite endianness of the host
+    bool swap = false;
+
+    // x, y and z are consecutive FLOAT32 values, which is the case for almost every sensor
+    bool packed_xyz() const
+    {
+        return datatype[CHANNEL_X] == POINT_FIELD_FLOAT32 && datatype[CHANNEL_Y] == POINT_FIELD_FLOAT32 &&
+               datatype[CHANNEL_Z] == POINT_FIELD_FLOAT32 && offset[CHANNEL_Y] == offset[CHANNEL_X] + 4 &&
+               offset[CHANNEL_Z] == offset[CHANNEL_X] + 8;
+    }
+};
+
+inline size_t point_field_size(uint8_t datatype)
+{
+    switch (datatype) {
+        case POINT_FIELD_INT8:
+        case POINT_FIELD_UINT8:
+            return 1;
+        case POINT_FIELD_INT16:
+        case POINT_FIELD_UINT16:
+            return 2;
+        case POINT_FIELD_INT32:
+        case POINT_FIELD_UINT32:
+        case POINT_FIELD_FLOAT32:
+            return 4;
+        case POINT_FIELD_FLOAT64:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+// Resolve the layout of a cloud, or return nothing if it has no usable x/y/z fields
+inline std::optional<PointLayout> resolve_point_layout(const PointCloud2View &cloud)
+{
+    static constexpr std::array<std::string_view, CHANNEL_COUNT> names = {"x", "y", "z", "intensity"};
+
+    PointLayout layout;
+    layout.point_step = cloud.point_step();
+    layout.swap = cloud.is_bigendian() == host_is_little_endian();
+    for (size_t c = 0; c < CHANNEL_COUNT; c++) {
+        const auto *field = cloud.fields().find(names[c]);
+        if (field == nullptr) {
+            if (c == CHANNEL_INTENSITY) {
+                continue;
+            }
+            return std::nullopt;
+        }
+        size_t size = point_field_size(field->datatype);
+        if (size == 0 || field->offset + size > cloud.point_step()) {
+            return std::nullopt;
+        }
+        layout.offset[c] = field->offset;
+        layout.datatype[c] = field->datatype;
+    }
+    layout.has_intensity = layout.datatype[CHANNEL_INTENSITY] != 0;
+    return layout;
+}
+
+// Resolving a layout means looking up fields by name: remember the last one,
+// since a given topic practically never changes its layout.
+class PointLayoutCache {
+   public:
+    const std::optional<PointLayout> &get(const PointCloud2View &cloud)
+    {
+        if (!_valid || !same_signature(cloud)) {
+            _layout = resolve_point_layout(cloud);
+            _point_step = cloud.point_step();
+            _is_bigendian = cloud.is_bigendian();
+            _nb_fields = cloud.fields().size();
+            for (size_t i = 0; i < _nb_fields; i++) {
+                _fields[i] = {cloud.fields()[i].offset, cloud.fields()[i].datatype, name_hash(cloud.fields()[i].name)};
+            }
+            _valid = true;
+        }
+        return _layout;
+    }
+
+   private:
+    struct FieldSignature {
+        uint32_t offset;
+        uint8_t datatype;
+        uint64_t name_hash;
+    };
+
+    static uint64_t name_hash(std::string_view name)
+    {
+        // FNV-1a
+        uint64_t h = 14695981039346656037ull;
+        for (char c : name) {
+            h = (h ^ uint8_t(c)) * 1099511628211ull;
+        }
+        return h;
+    }
+
+    bool same_signature(const PointCloud2View &cloud) const
+    {
+        if (cloud.point_step() != _point_step || cloud.is_bigendian() != _is_bigendian ||
+            cloud.fields().size() != _nb_fields) {
+            return false;
+        }
+        for (size_t i = 0; i < _nb_fields; i++) {
+            const auto &f = cloud.fields()[i];
+            if (f.offset != _fields[i].offset || f.datatype != _fields[i].datatype ||
+                name_hash(f.name) != _fields[i].name_hash) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool _valid = false;
+    std::optional<PointLayout> _layout;
+    uint32_t _point_step = 0;
+    bool _is_bigendian = false;
+    size_t _nb_fields = 0;
+    std::array<FieldSignature, POINT_CLOUD_MAX_FIELDS> _fields{};
+};
+
+// The channels of a point cloud, as contiguous arrays
+struct PointCloudSoA {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    // Empty if the cloud has no intensity field
+    std::vector<float> intensity;
+
+    size_t size() const { return x.size(); }
+
+    // Buffers are reused across clouds: resizing only allocates when a cloud is bigger than all the previous ones
+    void resize(size_t n, bool with_intensity)
+    {
+        x.resize(n);
+        y.resize(n);
+        z.resize(n);
+        intensity.resize(with_intensity ? n : 0);
+    }
+
+    float *channel(size_t c)
+    {
+        switch (c) {
+            case CHANNEL_X:
+                return x.data();
+            case CHANNEL_Y:
+                return y.data();
+            case CHANNEL_Z:
+                return z.data();
+            default:
+                return intensity.data();
+        }
+    }
+};
+
+enum class SimdLevel { Scalar, SSE, AVX2 };
+
+inline SimdLevel detect_simd_level()
+{
+#ifdef POINT_CLOUD_X86_SIMD
+    static const SimdLevel level = []() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return SimdLevel::AVX2;
+        }
+        if (__builtin_cpu_supports("ssse3")) {
+            return SimdLevel::SSE;
+        }
+        return SimdLevel::Scalar;
+    }();
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+namespace point_cloud_detail {
+
+template <typename T, typename U>
+inline float load_as_float(const uint8_t *p, bool swap)
+{
+    U bits;
+    std::memcpy(&bits, p, sizeof(U));
+    if (swap) {
+        if constexpr (sizeof(U) == 2) {
+            bits = __builtin_bswap16(bits);
+        } else if constexpr (sizeof(U) == 4) {
+            bits = __builtin_bswap32(bits);
+        } else if constexpr (sizeof(U) == 8) {
+            bits = __builtin_bswap64(bits);
+        }
+    }
+    T v;
+    std::memcpy(&v, &bits, sizeof(T));
+    return static_cast<float>(v);
+}
+
+inline float load_field(const uint8_t *p, uint8_t datatype, bool swap)
+{
+    switch (datatype) {
+        case POINT_FIELD_INT8:
+            return static_cast<float>(static_cast<int8_t>(*p));
+        case POINT_FIELD_UINT8:
+            return static_cast<float>(*p);
+        case POINT_FIELD_INT16:
+            return load_as_float<int16_t, uint16_t>(p, swap);
+        case POINT_FIELD_UINT16:
+            return load_as_float<uint16_t, uint16_t>(p, swap);
+        case POINT_FIELD_INT32:
+            return load_as_float<int32_t, uint32_t>(p, swap);
+        case POINT_FIELD_UINT32:
+            return load_as_float<uint32_t, uint32_t>(p, swap);
+        case POINT_FIELD_FLOAT32:
+            return load_as_float<float, uint32_t>(p, swap);
+        case POINT_FIELD_FLOAT64:
+            return load_as_float<double, uint64_t>(p, swap);
+        default:
+            return 0.0f;
+    }
+}
+
+inline void unpack_channel_scalar(const uint8_t *data, size_t begin, size_t end, uint32_t step, uint32_t offset,
+                                  uint8_t datatype, bool swap, float *dst)
+{
+    for (size_t i = begin; i < end; i++) {
+        dst[i] = load_field(data + i * step + offset, datatype, swap);
+    }
+}
+
+#ifdef POINT_CLOUD_X86_SIMD
+// Gather one FLOAT32 channel of 8 points at a time
+__attribute__((target("avx2"))) inline size_t unpack_channel_avx2(const uint8_t *data, size_t n, uint32_t step,
+                                                                   uint32_t offset, bool swap, float *dst)
+{
+    const __m256i indices = _mm256_setr_epi32(0, step, 2 * step, 3 * step, 4 * step, 5 * step, 6 * step, 7 * step);
+    const __m256i bswap =
+        _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8,
+                         15, 14, 13, 12);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        // The indices are relative to the block, so they can't overflow whatever the size of the cloud
+        const float *base = reinterpret_cast<const float *>(data + i * step + offset);
+        __m256 v = _mm256_i32gather_ps(base, indices, 1);
+        if (swap) {
+            v = _mm256_castsi256_ps(_mm256_shuffle_epi8(_mm256_castps_si256(v), bswap));
+        }
+        _mm256_storeu_ps(dst + i, v);
+    }
+    return i;
+}
+
+__attribute__((target("avx2"))) inline __m256 load_two_points_avx2(const uint8_t *lo, const uint8_t *hi, bool swap,
+                                                                   __m256i bswap)
+{
+    __m256 r = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(reinterpret_cast<const float *>(lo))),
+                                    _mm_loadu_ps(reinterpret_cast<const float *>(hi)), 1);
+    return swap ? _mm256_castsi256_ps(_mm256_shuffle_epi8(_mm256_castps_si256(r), bswap)) : r;
+}
+
+// Load x/y/z (and the following 4 bytes) of 8 points and transpose them.
+// Each 128-bit lane holds one point of the first half and one of the second half of the block.
+__attribute__((target("avx2"))) inline size_t unpack_xyz_avx2(const uint8_t *data, size_t n, size_t data_size,
+                                                               uint32_t step, uint32_t offset, bool swap,
+                                                               float *x, float *y, float *z, float *w)
+{
+    const __m256i bswap =
+        _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8,
+                         15, 14, 13, 12);
+    size_t i = 0;
+    for (; i + 8 <= n && (i + 7) * step + offset + 16 <= data_size; i += 8) {
+        const uint8_t *p = data + i * step + offset;
+        __m256 r0 = load_two_points_avx2(p, p + 4 * step, swap, bswap);
+        __m256 r1 = load_two_points_avx2(p + step, p + 5 * step, swap, bswap);
+        __m256 r2 = load_two_points_avx2(p + 2 * step, p + 6 * step, swap, bswap);
+        __m256 r3 = load_two_points_avx2(p + 3 * step, p + 7 * step, swap, bswap);
+        __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+        __m256 t1 = _mm256_unpacklo_ps(r2, r3);
+        __m256 t2 = _mm256_unpackhi_ps(r0, r1);
+        __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+        _mm256_storeu_ps(x + i, _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0)));
+        _mm256_storeu_ps(y + i, _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2)));
+        _mm256_storeu_ps(z + i, _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0)));
+        if (w != nullptr) {
+            _mm256_storeu_ps(w + i, _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2)));
+        }
+    }
+    return i;
+}
+
+// Load x/y/z (and the following 4 bytes) of 4 points and transpose them
+__attribute__((target("ssse3"))) inline size_t unpack_xyz_sse(const uint8_t *data, size_t n, size_t data_size,
+                                                               uint32_t step, uint32_t offset, bool swap,
+                                                               float *x, float *y, float *z, float *w)
+{
+    const __m128i bswap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    size_t i = 0;
+    // Each load reads 16 bytes, which may go past the last point
+    for (; i + 4 <= n && (i + 3) * step + offset + 16 <= data_size; i += 4) {
+        const uint8_t *p = data + i * step + offset;
+        __m128 r0 = _mm_loadu_ps(reinterpret_cast<const float *>(p));
+        __m128 r1 = _mm_loadu_ps(reinterpret_cast<const float *>(p + step));
+        __m128 r2 = _mm_loadu_ps(reinterpret_cast<const float *>(p + 2 * step));
+        __m128 r3 = _mm_loadu_ps(reinterpret_cast<const float *>(p + 3 * step));
+        if (swap) {
+            r0 = _mm_castsi128_ps(_mm_shuffle_epi8(_mm_castps_si128(r0), bswap));
+            r1 = _mm_castsi128_ps(_mm_shuffle_epi8(_mm_castps_si128(r1), bswap));
+            r2 = _mm_castsi128_ps(_mm_shuffle_epi8(_mm_castps_si128(r2), bswap));
+            r3 = _mm_castsi128_ps(_mm_shuffle_epi8(_mm_castps_si128(r3), bswap));
+        }
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _mm_storeu_ps(x + i, r0);
+        _mm_storeu_ps(y + i, r1);
+        _mm_storeu_ps(z + i, r2);
+        if (w != nullptr) {
+            _mm_storeu_ps(w + i, r3);
+        }
+    }
+    return i;
+}
+#endif
+
+}  // namespace point_cloud_detail
+
+// Unpack the points [begin, end) of `cloud` into `out`, whose buffers are reused.
+// Processing a large cloud range by range keeps the unpacked points in cache.
+// Invalid points (NaN) are kept as they are: filtering is up to the consumer.
+inline void unpack_points(const PointCloud2View &cloud, const PointLayout &layout, size_t begin, size_t end,
+                          PointCloudSoA &out, SimdLevel level = detect_simd_level())
+{
+    using namespace point_cloud_detail;
+
+    end = std::min(end, cloud.point_count());
+    begin = std::min(begin, end);
+    const size_t n = end - begin;
+    const uint32_t step = layout.point_step;
+    const uint8_t *data = cloud.data().data + begin * step;
+    const size_t data_size = cloud.data().size - begin * step;
+    out.resize(n, layout.has_intensity);
+    if (n == 0) {
+        return;
+    }
+
+    // How many points of each channel have been unpacked by a vectorized kernel
+    std::array<size_t, CHANNEL_COUNT> done{};
+    const size_t nb_channels = layout.has_intensity ? CHANNEL_COUNT : CHANNEL_INTENSITY;
+
+#ifdef POINT_CLOUD_X86_SIMD
+    if (level != SimdLevel::Scalar && layout.packed_xyz()) {
+        // Loading whole points and transposing them beats gathering each channel.
+        // The 4th lane is the intensity when it directly follows z, as in the usual x, y, z, intensity layout.
+        bool intensity_follows = layout.has_intensity && layout.datatype[CHANNEL_INTENSITY] == POINT_FIELD_FLOAT32 &&
+                                 layout.offset[CHANNEL_INTENSITY] == layout.offset[CHANNEL_X] + 12;
+        auto kernel = level == SimdLevel::AVX2 ? unpack_xyz_avx2 : unpack_xyz_sse;
+        size_t count = kernel(data, n, data_size, step, layout.offset[CHANNEL_X], layout.swap, out.x.data(),
+                              out.y.data(), out.z.data(), intensity_follows ? out.intensity.data() : nullptr);
+        done[CHANNEL_X] = done[CHANNEL_Y] = done[CHANNEL_Z] = count;
+        if (intensity_follows) {
+            done[CHANNEL_INTENSITY] = count;
+        }
+    }
+    if (level == SimdLevel::AVX2) {
+        for (size_t c = 0; c < nb_channels; c++) {
+            if (done[c] == 0 && layout.datatype[c] == POINT_FIELD_FLOAT32) {
+                done[c] = unpack_channel_avx2(data, n, step, layout.offset[c], layout.swap, out.channel(c));
+            }
+        }
+    }
+#else
+    (void)level;
+#endif
+
+    // Scalar fallback, for the remaining points and the other datatypes
+    for (size_t c = 0; c < nb_channels; c++) {
+        unpack_channel_scalar(data, done[c], n, step, layout.offset[c], layout.datatype[c], layout.swap,
+                              out.channel(c));
+    }
+}
+
+// Unpack all the points of `cloud` into `out`, whose buffers are reused
+inline void unpack_points(const PointCloud2View &cloud, const PointLayout &layout, PointCloudSoA &out,
+                          SimdLevel level = detect_simd_level())
+{
+    unpack_points(cloud, layout, 0, cloud.point_count(), out, level);
+}
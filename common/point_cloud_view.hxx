@@ -0,0 +1,158 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <string_view>
+
+#include "cdr_view.hxx"
+
+// Zero-copy views of sensor_msgs/msg/PointCloud2 (see common/idl/PointCloud2.idl).
+// Unlike the idlcxx-generated type, nothing is copied out of the payload:
+// strings and the `data` octet sequence point into the received buffer, which
+// must therefore outlive the view.
+
+struct TimeView {
+    int32_t sec = 0;
+    uint32_t nanosec = 0;
+};
+
+inline std::ostream &operator<<(std::ostream &os, const TimeView &t)
+{
+    auto fill = os.fill('0');
+    os << t.sec << "." << std::setw(9) << t.nanosec;
+    os.fill(fill);
+    return os;
+}
+
+struct HeaderView {
+    TimeView stamp;
+    std::string_view frame_id;
+};
+
+struct PointFieldView {
+    std::string_view name;
+    uint32_t offset = 0;
+    uint8_t datatype = 0;
+    uint32_t count = 0;
+};
+
+// The maximum number of fields a point cloud may declare.
+// Real sensors use a handful (x, y, z, intensity, ring, time...).
+#define POINT_CLOUD_MAX_FIELDS 32
+
+class PointFieldList {
+   public:
+    const PointFieldView *begin() const { return _fields.data(); }
+    const PointFieldView *end() const { return _fields.data() + _count; }
+    size_t size() const { return _count; }
+    bool empty() const { return _count == 0; }
+    const PointFieldView &operator[](size_t idx) const { return _fields[idx]; }
+
+    // Find a field by name, or return nullptr if it doesn't exist
+    const PointFieldView *find(std::string_view name) const
+    {
+        for (const auto &f : *this) {
+            if (f.name == name) {
+                return &f;
+            }
+        }
+        return nullptr;
+    }
+
+   private:
+    friend class PointCloud2View;
+    std::array<PointFieldView, POINT_CLOUD_MAX_FIELDS> _fields;
+    size_t _count = 0;
+};
+
+class PointCloud2View {
+   public:
+    // Parse a CDR payload, including its 4-byte encapsulation header.
+    static PointCloud2View parse(const uint8_t *payload, size_t len)
+    {
+        PointCloud2View view;
+        CdrReader reader(payload, len);
+        view._little_endian_cdr = reader.little_endian();
+
+        view._header.stamp.sec = reader.read_i32();
+        view._header.stamp.nanosec = reader.read_u32();
+        view._header.frame_id = reader.read_string();
+        view._height = reader.read_u32();
+        view._width = reader.read_u32();
+
+        // Each PointField takes at least 4 (name) + 4 (offset) + 1 (datatype) + 4 (count) bytes
+        uint32_t nb_fields = reader.read_sequence_length(13);
+        if (nb_fields > POINT_CLOUD_MAX_FIELDS) {
+            throw std::runtime_error("PointCloud2 has too many fields: " + std::to_string(nb_fields));
+        }
+        for (uint32_t i = 0; i < nb_fields; i++) {
+            auto &f = view._fields._fields[i];
+            f.name = reader.read_string();
+            f.offset = reader.read_u32();
+            f.datatype = reader.read_u8();
+            f.count = reader.read_u32();
+        }
+        view._fields._count = nb_fields;
+
+        view._is_bigendian = reader.read_bool();
+        view._point_step = reader.read_u32();
+        view._row_step = reader.read_u32();
+        uint32_t data_len = reader.read_sequence_length();
+        view._data = reader.read_octets(data_len);
+        view._is_dense = reader.read_bool();
+        return view;
+    }
+
+    static PointCloud2View parse(ByteSpan payload) { return parse(payload.data, payload.size); }
+
+    const HeaderView &header() const { return _header; }
+    uint32_t height() const { return _height; }
+    uint32_t width() const { return _width; }
+    const PointFieldList &fields() const { return _fields; }
+    bool is_bigendian() const { return _is_bigendian; }
+    uint32_t point_step() const { return _point_step; }
+    uint32_t row_step() const { return _row_step; }
+    ByteSpan data() const { return _data; }
+    bool is_dense() const { return _is_dense; }
+
+    // Endianness of the CDR encoding itself, which is unrelated to `is_bigendian` of the points.
+    bool little_endian_cdr() const { return _little_endian_cdr; }
+
+    // Number of points actually present in `data`, which is bounded by the buffer size
+    // even if width*height disagrees with it.
+    size_t point_count() const
+    {
+        if (_point_step == 0) {
+            return 0;
+        }
+        size_t declared = size_t(_width) * _height;
+        size_t available = _data.size / _point_step;
+        return declared < available ? declared : available;
+    }
+
+   private:
+    HeaderView _header;
+    uint32_t _height = 0;
+    uint32_t _width = 0;
+    PointFieldList _fields;
+    bool _is_bigendian = false;
+    uint32_t _point_step = 0;
+    uint32_t _row_step = 0;
+    ByteSpan _data;
+    bool _is_dense = false;
+    bool _little_endian_cdr = true;
+};
@@ -0,0 +1,383 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "zenoh.hxx"
+
+#include "mcap_recorder.hxx"
+#include "pipeline.hxx"
+#include "ros_graph.hxx"
+#include "ros_types.hxx"
+#include "topic_metrics.hxx"
+
+// The payload bytes held for all the topics whose publisher isn't known yet
+#define DISCOVERY_PENDING_BYTES (64 * 1024 * 1024)
+// The topics of a type waiting for a worker at once
+#define DISCOVERY_MAX_TOPICS 65536
+// The samples a worker processes from a topic before letting the other topics through
+#define DISCOVERY_DRAIN_BURST 16
+
+// A topic of a registered type, found in the graph or by receiving its samples
+struct DiscoveredTopic {
+    DiscoveredTopic(std::string name, std::string key, TopicMetrics &metrics)
+        : name(std::move(name)), key(std::move(key)), metrics(metrics)
+    {
+    }
+
+    const std::string name;
+    const std::string key;
+    TopicMetrics &metrics;
+    // Transient local topics, e.g. /tf_static, keep their latest samples for late joiners
+    std::atomic<bool> transient_local{false};
+
+   private:
+    friend class RosDiscovery;
+
+    std::mutex _mutex;
+    // Set once the liveliness token of a publisher tells the QoS of the topic.
+    // Until then, the samples are held, e.g. the /tf_static history received before the token.
+    bool _confirmed = false;
+    // The keep-last depth of a volatile topic. Transient local samples are never re-sent: they're never dropped.
+    size_t _depth = 0;
+    std::deque<Timed<zenoh::Sample>> _queue;
+    // Charged to the pending budget until the topic is confirmed
+    size_t _pending_bytes = 0;
+    // Owned by a worker, or waiting for one: the samples of a topic are processed in order
+    bool _scheduled = false;
+    size_t _nb_publishers = 0;
+};
+
+// Subscribes to the topics of the ROS 2 graph as their publishers appear,
+// instead of hard-coding them. The liveliness tokens of rmw_zenoh feed a
+// graph cache; the publishers of a registered type are then served by a single
+// wildcard subscription per type ("<domain_id>/**/<type_name>/<type_hash>"),
+// whatever the number of topics. The handler of a type is found from the type
+// hash in O(1). Each topic has its own queue, sized from its QoS, and the
+// topics with samples are handed to the workers of their type. A topic is
+// retired when the token of its last publisher is deleted.
+class RosDiscovery {
+   public:
+    using Handler = std::function<void(const Timed<zenoh::Sample> &, DiscoveredTopic &)>;
+
+    RosDiscovery(zenoh::Session &session, std::string domain_id, MetricsRegistry &metrics, size_t nb_workers,
+                 McapRecorder *recorder = nullptr)
+        : _session(session), _domain_id(std::move(domain_id)), _metrics(metrics), _nb_workers(nb_workers),
+          _recorder(recorder)
+    {
+    }
+
+    RosDiscovery(const RosDiscovery &) = delete;
+    RosDiscovery &operator=(const RosDiscovery &) = delete;
+
+    // Decode the messages of `type` with `handler`. The queue of each topic keeps the depth of its QoS history,
+    // up to `queue_depth` samples, and `history_depth` samples are requested from each transient local publisher.
+    // All the types must be registered before start().
+    void add_type(const RosType &type, size_t queue_depth, size_t history_depth, Handler handler)
+    {
+        auto &state = _types.add(type.hash, TypeState{});
+        state.type = &type;
+        state.queue_depth = queue_depth;
+        state.history_depth = history_depth;
+        state.handler = std::move(handler);
+        state.pipeline = std::make_unique<Pipeline<DiscoveredTopic *>>(
+            ros_type_name(type.dds_name), DISCOVERY_MAX_TOPICS, OverflowPolicy::DropNewest, _nb_workers,
+            [this, &state](DiscoveredTopic *&topic) { drain(state, *topic); });
+    }
+
+    // Subscribe to the liveliness tokens, including those of the entities already alive
+    void start()
+    {
+        auto options = zenoh::Session::LivelinessSubscriberOptions::create_default();
+        options.history = true;
+        _liveliness.emplace(_session.liveliness_declare_subscriber(
+            zenoh::KeyExpr(std::string(ROS_LIVELINESS_PREFIX "/") + _domain_id + "/**"),
+            [this](const zenoh::Sample &sample) { on_token(sample); }, zenoh::closures::none, std::move(options)));
+    }
+
+    const RosGraph &graph() const { return _graph; }
+
+    size_t nb_topics() const
+    {
+        std::shared_lock<std::shared_mutex> lock(_topics_mutex);
+        return _topics.size();
+    }
+
+    size_t nb_subscribers() const { return _nb_subscribers.load(std::memory_order_relaxed); }
+
+    // The samples dropped by the queues of all the topics
+    uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+   private:
+    struct TypeState {
+        const RosType *type = nullptr;
+        size_t queue_depth = 0;
+        size_t history_depth = 0;
+        Handler handler;
+        // Carries the topics with samples to process, each at most once
+        std::unique_ptr<Pipeline<DiscoveredTopic *>> pipeline;
+        // Declared when the first publisher of the type is discovered
+        std::optional<zenoh::ext::AdvancedSubscriber<void>> subscriber;
+    };
+
+    // Called by Zenoh for each liveliness token that appears or disappears
+    void on_token(const zenoh::Sample &sample)
+    {
+        auto token = sample.get_keyexpr().as_string_view();
+        if (sample.get_kind() == Z_SAMPLE_KIND_DELETE) {
+            auto entity = _graph.remove(token);
+            if (entity.has_value() && entity->kind == EntityKind::Publisher &&
+                _types.find(entity->type_hash) != nullptr) {
+                remove_publisher(ros_topic_key(*entity));
+            }
+            return;
+        }
+        auto entity = _graph.add(token);
+        if (!entity.has_value() || entity->kind != EntityKind::Publisher) {
+            return;
+        }
+        TypeState *state = _types.find(entity->type_hash);
+        if (state == nullptr) {
+            // Not a type we decode
+            return;
+        }
+        add_publisher(*state, ros_topic_key(*entity), entity->topic,
+                      parse_qos_history(entity->qos, state->queue_depth));
+        subscribe(*state);
+    }
+
+    // Set the QoS of the topic, and release the samples held until it was known
+    void add_publisher(TypeState &state, std::string_view key, const std::string &name, const QosHistory &qos)
+    {
+        std::shared_lock<std::shared_mutex> topics_lock(_topics_mutex);
+        DiscoveredTopic *topic = find_topic(topics_lock, key, name);
+        std::lock_guard<std::mutex> lock(topic->_mutex);
+        topic->_nb_publishers++;
+        // With several publishers, the topic keeps the deepest history
+        if (qos.transient_local) {
+            topic->transient_local.store(true, std::memory_order_relaxed);
+        }
+        topic->_depth = std::max(topic->_depth, std::min(qos.keep_all ? state.queue_depth : qos.depth,
+                                                         state.queue_depth));
+        if (!topic->_confirmed) {
+            topic->_confirmed = true;
+            _pending_bytes.fetch_sub(topic->_pending_bytes, std::memory_order_relaxed);
+            topic->_pending_bytes = 0;
+        }
+        trim(*topic);
+        schedule(state, *topic);
+    }
+
+    // Retire the topic with its last publisher. Its queued samples are still processed.
+    void remove_publisher(std::string_view key)
+    {
+        std::unique_lock<std::shared_mutex> topics_lock(_topics_mutex);
+        auto it = _topics.find(key);
+        if (it == _topics.end()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(it->second->_mutex);
+            if (it->second->_nb_publishers > 0 && --it->second->_nb_publishers > 0) {
+                return;
+            }
+        }
+        _retired.push_back(std::move(it->second));
+        _topics.erase(it);
+        // Free the retired topics that no worker holds anymore
+        for (auto r = _retired.begin(); r != _retired.end();) {
+            bool idle;
+            {
+                std::lock_guard<std::mutex> lock((*r)->_mutex);
+                idle = !(*r)->_scheduled;
+            }
+            if (idle) {
+                _metrics.remove((*r)->metrics);
+                r = _retired.erase(r);
+            } else {
+                ++r;
+            }
+        }
+    }
+
+    // One subscription for all the topics of a type
+    void subscribe(TypeState &state)
+    {
+        if (state.subscriber.has_value()) {
+            return;
+        }
+        using AdvancedSubscriberOptions = zenoh::ext::SessionExt::AdvancedSubscriberOptions;
+        auto options = AdvancedSubscriberOptions::create_default();
+        options.subscriber_detection = true;
+        options.query_timeout_ms = std::numeric_limits<uint64_t>::max();
+        // Get the history of the transient local publishers, including the late joiners.
+        // Volatile publishers have no cache and don't answer.
+        options.history = AdvancedSubscriberOptions::HistoryOptions::create_default();
+        options.history->detect_late_publishers = true;
+        options.history->max_samples = state.history_depth;
+        options.recovery.emplace().last_sample_miss_detection = AdvancedSubscriberOptions::RecoveryOptions::Heartbeat{};
+
+        std::string keyexpr = _domain_id + "/**/" + state.type->dds_name + "/" + state.type->hash;
+        state.subscriber.emplace(_session.ext().declare_advanced_subscriber(
+            zenoh::KeyExpr(keyexpr), [this, &state](const zenoh::Sample &sample) { on_sample(state, sample); },
+            zenoh::closures::none, std::move(options)));
+        _nb_subscribers.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Called by Zenoh for each sample of a registered type
+    void on_sample(TypeState &state, const zenoh::Sample &sample)
+    {
+        if (_recorder != nullptr) {
+            _recorder->record(sample, *state.type);
+        }
+        auto key = sample.get_keyexpr().as_string_view();
+        size_t size = sample.get_payload().size();
+        // Held until the sample is queued: a topic is only retired under the exclusive lock
+        std::shared_lock<std::shared_mutex> topics_lock(_topics_mutex);
+        // The sample may arrive before the liveliness token of its publisher
+        DiscoveredTopic *topic = find_topic(topics_lock, key, ros_topic_of_key(key));
+        std::lock_guard<std::mutex> lock(topic->_mutex);
+        if (!topic->_confirmed) {
+            // Whether the samples are static isn't known yet, and their publisher may never show up
+            if (topic->_queue.size() >= state.history_depth ||
+                _pending_bytes.fetch_add(size, std::memory_order_relaxed) + size > DISCOVERY_PENDING_BYTES) {
+                if (topic->_queue.size() < state.history_depth) {
+                    _pending_bytes.fetch_sub(size, std::memory_order_relaxed);
+                }
+                drop(*topic);
+                return;
+            }
+            topic->_pending_bytes += size;
+            topic->_queue.push_back({sample.clone(), system_time_ns()});
+            return;
+        }
+        topic->_queue.push_back({sample.clone(), system_time_ns()});
+        trim(*topic);
+        schedule(state, *topic);
+    }
+
+    // Runs on the workers of the type, which own the topic until its queue is empty
+    void drain(TypeState &state, DiscoveredTopic &topic)
+    {
+        for (size_t n = 0; n < DISCOVERY_DRAIN_BURST; n++) {
+            std::optional<Timed<zenoh::Sample>> timed;
+            {
+                std::lock_guard<std::mutex> lock(topic._mutex);
+                if (topic._queue.empty()) {
+                    topic._scheduled = false;
+                    return;
+                }
+                timed.emplace(std::move(topic._queue.front()));
+                topic._queue.pop_front();
+            }
+            try {
+                state.handler(*timed, topic);
+            } catch (const std::exception &e) {
+                std::cerr << "[" << topic.name << "] Handler failed: " << e.what() << std::endl;
+            }
+        }
+        // Let the other topics of the type through
+        std::lock_guard<std::mutex> lock(topic._mutex);
+        topic._scheduled = false;
+        schedule(state, topic);
+    }
+
+    // Called with the lock of the topic
+    void schedule(TypeState &state, DiscoveredTopic &topic)
+    {
+        if (topic._scheduled || topic._queue.empty()) {
+            return;
+        }
+        // Only fails with more than DISCOVERY_MAX_TOPICS topics waiting: the next sample retries
+        topic._scheduled = state.pipeline->push(&topic);
+    }
+
+    // Called with the lock of the topic: KEEP_LAST semantics for the volatile topics
+    void trim(DiscoveredTopic &topic)
+    {
+        if (topic.transient_local.load(std::memory_order_relaxed)) {
+            return;
+        }
+        while (topic._queue.size() > topic._depth) {
+            topic._queue.pop_front();
+            drop(topic);
+        }
+    }
+
+    void drop(DiscoveredTopic &topic)
+    {
+        topic.metrics.record_dropped(1);
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // The topic of `key`, added if needed. The shared lock is only released meanwhile.
+    DiscoveredTopic *find_topic(std::shared_lock<std::shared_mutex> &topics_lock, std::string_view key,
+                                const std::string &name)
+    {
+        auto it = _topics.find(key);
+        if (it != _topics.end()) {
+            return it->second.get();
+        }
+        topics_lock.unlock();
+        {
+            std::unique_lock<std::shared_mutex> lock(_topics_mutex);
+            if (_topics.find(key) == _topics.end()) {
+                auto topic = std::make_unique<DiscoveredTopic>(name, std::string(key), _metrics.add(name));
+                // The map is keyed by a view of the key owned by the topic, so lookups don't allocate
+                std::string_view owned_key(topic->key);
+                _topics.emplace(owned_key, std::move(topic));
+            }
+        }
+        topics_lock.lock();
+        // Retired meanwhile: added again
+        it = _topics.find(key);
+        return it != _topics.end() ? it->second.get() : find_topic(topics_lock, key, name);
+    }
+
+    zenoh::Session &_session;
+    const std::string _domain_id;
+    MetricsRegistry &_metrics;
+    const size_t _nb_workers;
+    McapRecorder *_recorder;
+
+    RosGraph _graph;
+
+    // The topics outlive the pipelines, which point to them
+    mutable std::shared_mutex _topics_mutex;
+    std::unordered_map<std::string_view, std::unique_ptr<DiscoveredTopic>> _topics;
+    // Removed from the map, but still owned by a worker
+    std::vector<std::unique_ptr<DiscoveredTopic>> _retired;
+    std::atomic<size_t> _pending_bytes{0};
+    std::atomic<uint64_t> _dropped{0};
+
+    TypeDispatcher<TypeState> _types;
+    std::atomic<size_t> _nb_subscribers{0};
+
+    // Declared last, so that no new entity is discovered while the rest is destroyed
+    std::optional<zenoh::Subscriber<void>> _liveliness;
+};
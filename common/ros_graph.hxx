@@ -0,0 +1,286 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// The ROS 2 graph as announced by rmw_zenoh through liveliness tokens:
+//   @ros2_lv/<domain_id>/<zid>/<node_id>/<entity_id>/<kind>/<enclave>/<namespace>/<node_name>
+//            [/<topic_name>/<type_name>/<type_hash>/<qos>]
+// Names are mangled: '/' is replaced by '%'.
+//   https://github.com/ros2/rmw_zenoh/blob/rolling/docs/design.md#graph-cache
+
+#define ROS_LIVELINESS_PREFIX "@ros2_lv"
+
+enum class EntityKind { Node, Publisher, Subscription, Service, Client };
+
+struct RosEntity {
+    std::string domain_id;
+    std::string zid;
+    std::string node_id;
+    std::string entity_id;
+    EntityKind kind = EntityKind::Node;
+    std::string node_namespace;
+    std::string node_name;
+    // Only for publishers, subscriptions, services and clients
+    std::string topic;
+    std::string type_name;
+    std::string type_hash;
+    std::string qos;
+};
+
+// "%robot1%scan" -> "/robot1/scan"
+inline std::string demangle_ros_name(std::string_view mangled)
+{
+    std::string name(mangled);
+    for (auto &c : name) {
+        if (c == '%') {
+            c = '/';
+        }
+    }
+    return name;
+}
+
+inline std::optional<EntityKind> parse_entity_kind(std::string_view v)
+{
+    if (v == "NN") {
+        return EntityKind::Node;
+    } else if (v == "MP") {
+        return EntityKind::Publisher;
+    } else if (v == "MS") {
+        return EntityKind::Subscription;
+    } else if (v == "SS") {
+        return EntityKind::Service;
+    } else if (v == "SC") {
+        return EntityKind::Client;
+    }
+    return std::nullopt;
+}
+
+// Parse a liveliness token, or return nothing if it isn't one of a ROS 2 entity
+inline std::optional<RosEntity> parse_liveliness_token(std::string_view key)
+{
+    std::array<std::string_view, 13> parts;
+    size_t nb_parts = 0;
+    while (nb_parts < parts.size()) {
+        size_t end = key.find('/');
+        parts[nb_parts++] = key.substr(0, end);
+        if (end == std::string_view::npos) {
+            key = {};
+            break;
+        }
+        key = key.substr(end + 1);
+    }
+    if (!key.empty() || nb_parts < 9 || parts[0] != ROS_LIVELINESS_PREFIX) {
+        return std::nullopt;
+    }
+    auto kind = parse_entity_kind(parts[5]);
+    if (!kind.has_value() || (*kind == EntityKind::Node) != (nb_parts == 9)) {
+        return std::nullopt;
+    }
+    if (*kind != EntityKind::Node && nb_parts != 13) {
+        return std::nullopt;
+    }
+
+    RosEntity e;
+    e.domain_id = parts[1];
+    e.zid = parts[2];
+    e.node_id = parts[3];
+    e.entity_id = parts[4];
+    e.kind = *kind;
+    e.node_namespace = demangle_ros_name(parts[7]);
+    e.node_name = parts[8];
+    if (*kind != EntityKind::Node) {
+        e.topic = demangle_ros_name(parts[9]);
+        e.type_name = parts[10];
+        e.type_hash = parts[11];
+        e.qos = parts[12];
+    }
+    return e;
+}
+
+// The key expression of the publications of a topic: "<domain_id>/<topic>/<type_name>/<type_hash>"
+inline std::string ros_topic_key(const RosEntity &e)
+{
+    std::string_view topic(e.topic);
+    if (!topic.empty() && topic[0] == '/') {
+        topic.remove_prefix(1);
+    }
+    return e.domain_id + "/" + std::string(topic) + "/" + e.type_name + "/" + e.type_hash;
+}
+
+// A cache of the graph, updated from the liveliness tokens as they appear and disappear
+class RosGraph {
+   public:
+    struct TopicInfo {
+        std::string type_name;
+        std::string type_hash;
+        size_t nb_publishers = 0;
+        size_t nb_subscriptions = 0;
+    };
+
+    // Returns the entity if it's new
+    std::optional<RosEntity> add(std::string_view token)
+    {
+        auto entity = parse_liveliness_token(token);
+        if (!entity.has_value()) {
+            return std::nullopt;
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto [it, inserted] = _entities.emplace(std::string(token), *entity);
+        if (!inserted) {
+            return std::nullopt;
+        }
+        update(it->second, true);
+        return entity;
+    }
+
+    // Returns the entity if it was known
+    std::optional<RosEntity> remove(std::string_view token)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _entities.find(std::string(token));
+        if (it == _entities.end()) {
+            return std::nullopt;
+        }
+        RosEntity entity = std::move(it->second);
+        _entities.erase(it);
+        update(entity, false);
+        return entity;
+    }
+
+    std::optional<TopicInfo> topic(const std::string &name) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _topics.find(name);
+        if (it == _topics.end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    size_t nb_topics() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _topics.size();
+    }
+
+    size_t nb_entities() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _entities.size();
+    }
+
+   private:
+    void update(const RosEntity &e, bool added)
+    {
+        if (e.kind != EntityKind::Publisher && e.kind != EntityKind::Subscription) {
+            return;
+        }
+        auto &info = _topics[e.topic];
+        info.type_name = e.type_name;
+        info.type_hash = e.type_hash;
+        auto &count = e.kind == EntityKind::Publisher ? info.nb_publishers : info.nb_subscriptions;
+        if (added) {
+            count++;
+        } else if (count > 0) {
+            count--;
+        }
+        if (info.nb_publishers == 0 && info.nb_subscriptions == 0) {
+            _topics.erase(e.topic);
+        }
+    }
+
+    mutable std::mutex _mutex;
+    std::unordered_map<std::string, RosEntity> _entities;
+    std::map<std::string, TopicInfo> _topics;
+};
+
+// The maximum number of message types that can be registered for dispatch
+#define TYPE_DISPATCH_CAPACITY 256
+
+// Maps type hashes ("RIHS01_<sha256>") to what handles their messages.
+// The hashes are already uniformly distributed: the first 64 bits of the
+// digest index an open-addressing table, and lookups never allocate.
+// Types are registered at startup; lookups are read-only afterwards.
+template <typename T>
+class TypeDispatcher {
+   public:
+    T &add(std::string_view type_hash, T value)
+    {
+        if (_size >= TYPE_DISPATCH_CAPACITY / 2) {
+            throw std::runtime_error("Too many message types, the maximum is " +
+                                     std::to_string(TYPE_DISPATCH_CAPACITY / 2));
+        }
+        size_t i = index_of(type_hash);
+        while (_slots[i] != nullptr) {
+            if (_slots[i]->hash == type_hash) {
+                throw std::runtime_error("Type " + std::string(type_hash) + " is already registered");
+            }
+            i = (i + 1) & (TYPE_DISPATCH_CAPACITY - 1);
+        }
+        _slots[i] = std::make_unique<Entry>(Entry{std::string(type_hash), std::move(value)});
+        _size++;
+        return _slots[i]->value;
+    }
+
+    T *find(std::string_view type_hash)
+    {
+        for (size_t i = index_of(type_hash); _slots[i] != nullptr; i = (i + 1) & (TYPE_DISPATCH_CAPACITY - 1)) {
+            if (_slots[i]->hash == type_hash) {
+                return &_slots[i]->value;
+            }
+        }
+        return nullptr;
+    }
+
+    size_t size() const { return _size; }
+
+   private:
+    struct Entry {
+        std::string hash;
+        T value;
+    };
+
+    static size_t index_of(std::string_view type_hash)
+    {
+        constexpr std::string_view prefix = "RIHS01_";
+        uint64_t h = 0;
+        if (type_hash.substr(0, prefix.size()) == prefix && type_hash.size() >= prefix.size() + 16) {
+            for (size_t i = prefix.size(); i < prefix.size() + 16; i++) {
+                char c = type_hash[i];
+                h = (h << 4) | uint64_t(c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+            }
+        } else {
+            // Not a RIHS01 hash: FNV-1a
+            h = 0xcbf29ce484222325ull;
+            for (char c : type_hash) {
+                h = (h ^ uint8_t(c)) * 0x100000001b3ull;
+            }
+        }
+        return size_t(h) & (TYPE_DISPATCH_CAPACITY - 1);
+    }
+
+    std::array<std::unique_ptr<Entry>, TYPE_DISPATCH_CAPACITY> _slots;
+    size_t _size = 0;
+};
@@ -0,0 +1,142 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// The DDS type names and the type hashes of the ROS 2 messages we handle, as used by rmw_zenoh
+// in key expressions and liveliness tokens:
+//   https://github.com/ros2/rmw_zenoh/blob/rolling/docs/design.md#topic-and-service-name-mapping-to-zenoh-key-expressions
+// The type hashes are the ones of ROS 2 Jazzy.
+#define TF_MESSAGE_TYPE_NAME   "tf2_msgs::msg::dds_::TFMessage_"
+#define TF_MESSAGE_TYPE_HASH   "RIHS01_e369d0f05a23ae52508854b66f6aa0437f3449d652e8cbf22d5abe85d020f087"
+#define POINT_CLOUD2_TYPE_NAME "sensor_msgs::msg::dds_::PointCloud2_"
+#define POINT_CLOUD2_TYPE_HASH "RIHS01_9198cabf7da3796ae6fe19c4cb3bdd3525492988c70522628af5daa124bae2b5"
+
+// The message definitions of those types, in the "ros2msg" format that rosbag2 stores
+// in the schemas of MCAP files, with their dependencies appended.
+#define ROS_MSG_DEFINITION_SEPARATOR \
+    "================================================================================\n"
+
+#define STD_MSGS_HEADER_DEFINITION \
+    ROS_MSG_DEFINITION_SEPARATOR   \
+    "MSG: std_msgs/Header\n"       \
+    "builtin_interfaces/Time stamp\n" \
+    "string frame_id\n"            \
+    ROS_MSG_DEFINITION_SEPARATOR   \
+    "MSG: builtin_interfaces/Time\n" \
+    "int32 sec\n"                  \
+    "uint32 nanosec\n"
+
+#define TF_MESSAGE_DEFINITION                    \
+    "geometry_msgs/TransformStamped[] transforms\n" \
+    ROS_MSG_DEFINITION_SEPARATOR                 \
+    "MSG: geometry_msgs/TransformStamped\n"      \
+    "std_msgs/Header header\n"                   \
+    "string child_frame_id\n"                    \
+    "Transform transform\n"                      \
+    ROS_MSG_DEFINITION_SEPARATOR                 \
+    "MSG: geometry_msgs/Transform\n"             \
+    "Vector3 translation\n"                      \
+    "Quaternion rotation\n"                      \
+    ROS_MSG_DEFINITION_SEPARATOR                 \
+    "MSG: geometry_msgs/Quaternion\n"            \
+    "float64 x 0\n"                              \
+    "float64 y 0\n"                              \
+    "float64 z 0\n"                              \
+    "float64 w 1\n"                              \
+    ROS_MSG_DEFINITION_SEPARATOR                 \
+    "MSG: geometry_msgs/Vector3\n"               \
+    "float64 x\n"                                \
+    "float64 y\n"                                \
+    "float64 z\n"                                \
+    STD_MSGS_HEADER_DEFINITION
+
+#define POINT_CLOUD2_DEFINITION          \
+    "std_msgs/Header header\n"           \
+    "uint32 height\n"                    \
+    "uint32 width\n"                     \
+    "PointField[] fields\n"              \
+    "bool is_bigendian\n"                \
+    "uint32 point_step\n"                \
+    "uint32 row_step\n"                  \
+    "uint8[] data\n"                     \
+    "bool is_dense\n"                    \
+    ROS_MSG_DEFINITION_SEPARATOR         \
+    "MSG: sensor_msgs/PointField\n"      \
+    "uint8 INT8    = 1\n"                \
+    "uint8 UINT8   = 2\n"                \
+    "uint8 INT16   = 3\n"                \
+    "uint8 UINT16  = 4\n"                \
+    "uint8 INT32   = 5\n"                \
+    "uint8 UINT32  = 6\n"                \
+    "uint8 FLOAT32 = 7\n"                \
+    "uint8 FLOAT64 = 8\n"                \
+    "string name\n"                      \
+    "uint32 offset\n"                    \
+    "uint8  datatype\n"                  \
+    "uint32 count\n"                     \
+    STD_MSGS_HEADER_DEFINITION
+
+// A ROS 2 message type, as needed to describe recorded samples
+struct RosType {
+    // The DDS type name, e.g. "tf2_msgs::msg::dds_::TFMessage_"
+    const char *dds_name;
+    const char *hash;
+    // The ros2msg definition, or nullptr if unknown
+    const char *definition;
+};
+
+inline const RosType TF_MESSAGE_TYPE{TF_MESSAGE_TYPE_NAME, TF_MESSAGE_TYPE_HASH, TF_MESSAGE_DEFINITION};
+inline const RosType POINT_CLOUD2_TYPE{POINT_CLOUD2_TYPE_NAME, POINT_CLOUD2_TYPE_HASH, POINT_CLOUD2_DEFINITION};
+
+// "tf2_msgs::msg::dds_::TFMessage_" -> "tf2_msgs/msg/TFMessage"
+inline std::string ros_type_name(std::string_view dds_name)
+{
+    std::string name;
+    size_t pos = 0;
+    while (pos <= dds_name.size()) {
+        size_t end = dds_name.find("::", pos);
+        auto part = dds_name.substr(pos, end == std::string_view::npos ? std::string_view::npos : end - pos);
+        if (part != "dds_") {
+            if (!name.empty()) {
+                name += '/';
+            }
+            name += part;
+        }
+        if (end == std::string_view::npos) {
+            break;
+        }
+        pos = end + 2;
+    }
+    if (!name.empty() && name.back() == '_') {
+        name.pop_back();
+    }
+    return name;
+}
+
+// The ROS topic name of a key expression, either "<topic>" as routed by zenoh-bridge-ros2dds,
+// or "<domain_id>/<topic>/<type_name>/<type_hash>" as published by rmw_zenoh
+inline std::string ros_topic_of_key(std::string_view key)
+{
+    size_t last = key.rfind('/');
+    if (last != std::string_view::npos && key.substr(last + 1).rfind("RIHS", 0) == 0) {
+        size_t type = key.rfind('/', last - 1);
+        size_t domain = key.find('/');
+        if (type != std::string_view::npos && domain < type) {
+            key = key.substr(domain + 1, type - domain - 1);
+        }
+    }
+    return "/" + std::string(key);
+}
@@ -0,0 +1,159 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "cdr_view.hxx"
+#include "idl_cdr.hxx"
+#include "point_cloud_fields.hxx"
+
+#include "PointCloud2.hpp"
+#include "TFMessage.hpp"
+
+// Synthetic CDR payloads standing in for the messages of a real ROS 2 graph.
+// They are serialized once with the idlcxx types, then only re-stamped in
+// place before each publication.
+class SyntheticPayload {
+   public:
+    SyntheticPayload(std::vector<uint8_t> bytes, std::vector<size_t> stamp_offsets)
+        : _bytes(std::move(bytes)), _stamp_offsets(std::move(stamp_offsets))
+    {
+        _swap = parse_cdr_encapsulation(_bytes.data(), _bytes.size()).little_endian != host_is_little_endian();
+    }
+
+    const std::vector<uint8_t> &bytes() const { return _bytes; }
+    size_t size() const { return _bytes.size(); }
+
+    // Write `stamp_ns` into all the header stamps of the message
+    void stamp(int64_t stamp_ns)
+    {
+        uint32_t sec = uint32_t(stamp_ns / 1000000000);
+        uint32_t nanosec = uint32_t(stamp_ns % 1000000000);
+        if (_swap) {
+            sec = __builtin_bswap32(sec);
+            nanosec = __builtin_bswap32(nanosec);
+        }
+        for (size_t offset : _stamp_offsets) {
+            std::memcpy(_bytes.data() + offset, &sec, sizeof(sec));
+            std::memcpy(_bytes.data() + offset + sizeof(sec), &nanosec, sizeof(nanosec));
+        }
+    }
+
+   private:
+    std::vector<uint8_t> _bytes;
+    // Offsets of the std_msgs/Time stamps in the payload, including the encapsulation header
+    std::vector<size_t> _stamp_offsets;
+    bool _swap = false;
+};
+
+// A deterministic pseudo-random generator, so that payloads are reproducible
+class SyntheticRng {
+   public:
+    explicit SyntheticRng(uint64_t seed = 0x2545F4914F6CDD1Dull) : _state(seed) {}
+
+    uint64_t next()
+    {
+        // xorshift64*
+        _state ^= _state >> 12;
+        _state ^= _state << 25;
+        _state ^= _state >> 27;
+        return _state * 0x2545F4914F6CDD1Dull;
+    }
+
+    float uniform(float lo, float hi) { return lo + (hi - lo) * float(next() >> 40) / float(1 << 24); }
+
+   private:
+    uint64_t _state;
+};
+
+// A single-row cloud of x, y, z, intensity FLOAT32 points (point_step 16) of about `data_size` bytes
+inline SyntheticPayload make_point_cloud(size_t data_size, bool little_endian = host_is_little_endian(),
+                                         const std::string &frame_id = "lidar")
+{
+    const uint32_t point_step = 16;
+    const uint32_t nb_points = uint32_t(data_size / point_step);
+
+    sensor_msgs::msg::PointCloud2 msg;
+    msg.header().frame_id(frame_id);
+    msg.height(1);
+    msg.width(nb_points);
+    const char *names[] = {"x", "y", "z", "intensity"};
+    std::vector<sensor_msgs::msg::PointField> fields(4);
+    for (uint32_t i = 0; i < 4; i++) {
+        fields[i].name(names[i]);
+        fields[i].offset(i * 4);
+        fields[i].datatype(POINT_FIELD_FLOAT32);
+        fields[i].count(1);
+    }
+    msg.fields(fields);
+    msg.is_bigendian(!little_endian);
+    msg.point_step(point_step);
+    msg.row_step(point_step * nb_points);
+    msg.is_dense(true);
+
+    std::vector<uint8_t> data(size_t(nb_points) * point_step);
+    SyntheticRng rng;
+    for (size_t i = 0; i < data.size(); i += 4) {
+        // A 100m wide scene, and intensities in [0, 255]
+        float v = (i % point_step) == 12 ? rng.uniform(0.0f, 255.0f) : rng.uniform(-50.0f, 50.0f);
+        uint32_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        if (little_endian != host_is_little_endian()) {
+            bits = __builtin_bswap32(bits);
+        }
+        std::memcpy(data.data() + i, &bits, sizeof(bits));
+    }
+    msg.data(std::move(data));
+
+    // The header stamp is the very first member
+    return SyntheticPayload(write_idl(msg, little_endian), {CDR_ENCAPSULATION_SIZE});
+}
+
+// A TFMessage of `nb_transforms` frames, all children of "base_link"
+inline SyntheticPayload make_tf_message(size_t nb_transforms, bool little_endian = host_is_little_endian())
+{
+    tf2_msgs::msg::TFMessage msg;
+    SyntheticRng rng;
+    for (size_t i = 0; i < nb_transforms; i++) {
+        geometry_msgs::msg::TransformStamped t;
+        t.header().frame_id("base_link");
+        t.child_frame_id("frame_" + std::to_string(i));
+        t.transform().translation().x(rng.uniform(-1.0f, 1.0f));
+        t.transform().translation().y(rng.uniform(-1.0f, 1.0f));
+        t.transform().translation().z(rng.uniform(-1.0f, 1.0f));
+        t.transform().rotation().w(1.0);
+        msg.transforms().push_back(std::move(t));
+    }
+    auto bytes = write_idl(msg, little_endian);
+
+    // Find the stamp of each transform
+    std::vector<size_t> offsets;
+    CdrReader reader(bytes.data(), bytes.size());
+    uint32_t n = reader.read_u32();
+    for (uint32_t i = 0; i < n; i++) {
+        reader.align(4);
+        offsets.push_back(CDR_ENCAPSULATION_SIZE + reader.position());
+        reader.read_i32();
+        reader.read_u32();
+        reader.read_string();
+        reader.read_string();
+        for (int j = 0; j < 7; j++) {
+            reader.read_f64();
+        }
+    }
+    return SyntheticPayload(std::move(bytes), std::move(offsets));
+}
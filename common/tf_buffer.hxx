@@ -0,0 +1,678 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// An in-process transform cache, fed by the /tf and /tf_static subscribers.
+// Frame names are interned to integer handles, each frame keeps a ring of its
+// latest transforms to its parent, and lookups never take a lock: readers
+// validate what they read against sequence numbers (seqlock) and retry if a
+// writer got in the way.
+
+using FrameId = uint32_t;
+#define TF_INVALID_FRAME UINT32_MAX
+
+// The maximum length of a chain of frames, which also protects lookups against cycles
+#define TF_MAX_CHAIN_DEPTH 64
+
+struct Vec3 {
+    double x = 0;
+    double y = 0;
+    double z = 0;
+};
+
+struct Quat {
+    double x = 0;
+    double y = 0;
+    double z = 0;
+    double w = 1;
+};
+
+inline Quat operator*(const Quat &a, const Quat &b)
+{
+    return {a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+            a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+            a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+            a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z};
+}
+
+inline Vec3 rotate(const Quat &q, const Vec3 &v)
+{
+    // v + 2 * cross(q.xyz, cross(q.xyz, v) + q.w * v)
+    Vec3 u{q.y * v.z - q.z * v.y + q.w * v.x, q.z * v.x - q.x * v.z + q.w * v.y, q.x * v.y - q.y * v.x + q.w * v.z};
+    return {v.x + 2 * (q.y * u.z - q.z * u.y), v.y + 2 * (q.z * u.x - q.x * u.z), v.z + 2 * (q.x * u.y - q.y * u.x)};
+}
+
+inline Quat slerp(const Quat &a, Quat b, double t)
+{
+    double dot = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    // Take the shortest path
+    if (dot < 0) {
+        b = {-b.x, -b.y, -b.z, -b.w};
+        dot = -dot;
+    }
+    double wa, wb;
+    if (dot > 0.9995) {
+        // Nearly identical rotations: linear interpolation is accurate and avoids dividing by sin(~0)
+        wa = 1 - t;
+        wb = t;
+    } else {
+        double theta = std::acos(dot);
+        double sin_theta = std::sin(theta);
+        wa = std::sin((1 - t) * theta) / sin_theta;
+        wb = std::sin(t * theta) / sin_theta;
+    }
+    Quat q{wa * a.x + wb * b.x, wa * a.y + wb * b.y, wa * a.z + wb * b.z, wa * a.w + wb * b.w};
+    double norm = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+    return {q.x / norm, q.y / norm, q.z / norm, q.w / norm};
+}
+
+// A rigid transform, mapping points of a child frame into its parent frame
+struct Transform {
+    Vec3 translation;
+    Quat rotation;
+
+    Transform inverse() const
+    {
+        Quat inv{-rotation.x, -rotation.y, -rotation.z, rotation.w};
+        Vec3 t = rotate(inv, translation);
+        return {{-t.x, -t.y, -t.z}, inv};
+    }
+
+    Vec3 apply(const Vec3 &p) const
+    {
+        Vec3 r = rotate(rotation, p);
+        return {r.x + translation.x, r.y + translation.y, r.z + translation.z};
+    }
+};
+
+// (a * b) maps points of b's child frame into a's parent frame
+inline Transform operator*(const Transform &a, const Transform &b)
+{
+    return {a.apply(b.translation), a.rotation * b.rotation};
+}
+
+inline Transform interpolate(const Transform &a, const Transform &b, double t)
+{
+    return {{a.translation.x + (b.translation.x - a.translation.x) * t,
+             a.translation.y + (b.translation.y - a.translation.y) * t,
+             a.translation.z + (b.translation.z - a.translation.z) * t},
+            slerp(a.rotation, b.rotation, t)};
+}
+
+// Interns frame names to FrameId.
+// This is an insert-only open-addressing table: lookups are lock-free, only
+// the insertion of a new name takes a lock. Names are never removed, so the
+// views returned by name() stay valid for the lifetime of the registry.
+class FrameRegistry {
+   public:
+    explicit FrameRegistry(size_t max_frames)
+        : _max_frames(max_frames),
+          _nb_slots(slots_for(max_frames)),
+          _slots(new std::atomic<const Entry *>[_nb_slots]),
+          _by_id(new std::atomic<const Entry *>[max_frames])
+    {
+        for (size_t i = 0; i < _nb_slots; i++) {
+            _slots[i].store(nullptr, std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < max_frames; i++) {
+            _by_id[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    FrameRegistry(const FrameRegistry &) = delete;
+    FrameRegistry &operator=(const FrameRegistry &) = delete;
+
+    // tf2 ignores a leading '/' in frame names
+    static std::string_view normalize(std::string_view name)
+    {
+        return (!name.empty() && name[0] == '/') ? name.substr(1) : name;
+    }
+
+    FrameId find(std::string_view name) const
+    {
+        name = normalize(name);
+        uint64_t h = hash(name);
+        for (size_t i = h & (_nb_slots - 1);; i = (i + 1) & (_nb_slots - 1)) {
+            const Entry *e = _slots[i].load(std::memory_order_acquire);
+            if (e == nullptr) {
+                return TF_INVALID_FRAME;
+            }
+            if (e->hash == h && e->name == name) {
+                return e->id;
+            }
+        }
+    }
+
+    // Return the id of `name`, registering it if needed. Throws if the registry is full.
+    FrameId intern(std::string_view name)
+    {
+        FrameId id = find(name);
+        if (id != TF_INVALID_FRAME) {
+            return id;
+        }
+        name = normalize(name);
+        std::lock_guard<std::mutex> lock(_mutex);
+        // Another writer may have inserted it in the meantime
+        id = find(name);
+        if (id != TF_INVALID_FRAME) {
+            return id;
+        }
+        if (_entries.size() >= _max_frames) {
+            throw std::runtime_error("Too many TF frames, the maximum is " + std::to_string(_max_frames));
+        }
+        uint64_t h = hash(name);
+        _entries.push_back(std::make_unique<Entry>(Entry{std::string(name), h, FrameId(_entries.size())}));
+        const Entry *e = _entries.back().get();
+        _by_id[e->id].store(e, std::memory_order_release);
+        size_t i = h & (_nb_slots - 1);
+        while (_slots[i].load(std::memory_order_relaxed) != nullptr) {
+            i = (i + 1) & (_nb_slots - 1);
+        }
+        _slots[i].store(e, std::memory_order_release);
+        _size.store(_entries.size(), std::memory_order_release);
+        return e->id;
+    }
+
+    std::string_view name(FrameId id) const
+    {
+        if (id >= _max_frames) {
+            return {};
+        }
+        const Entry *e = _by_id[id].load(std::memory_order_acquire);
+        return e != nullptr ? std::string_view(e->name) : std::string_view();
+    }
+
+    size_t size() const { return _size.load(std::memory_order_acquire); }
+    size_t capacity() const { return _max_frames; }
+
+   private:
+    struct Entry {
+        std::string name;
+        uint64_t hash;
+        FrameId id;
+    };
+
+    // Keep the table at most half full
+    static size_t slots_for(size_t max_frames)
+    {
+        size_t n = 16;
+        while (n < 2 * max_frames) {
+            n <<= 1;
+        }
+        return n;
+    }
+
+    static uint64_t hash(std::string_view s)
+    {
+        // FNV-1a
+        uint64_t h = 14695981039346656037ull;
+        for (char c : s) {
+            h = (h ^ uint8_t(c)) * 1099511628211ull;
+        }
+        return h;
+    }
+
+    const size_t _max_frames;
+    const size_t _nb_slots;
+    std::unique_ptr<std::atomic<const Entry *>[]> _slots;
+    std::unique_ptr<std::atomic<const Entry *>[]> _by_id;
+    std::atomic<size_t> _size{0};
+
+    std::mutex _mutex;
+    std::vector<std::unique_ptr<Entry>> _entries;
+};
+
+enum class TfError {
+    None,
+    UnknownFrame,   // one of the frames has never been seen
+    NoData,         // a frame of the chain has no transform at all
+    Extrapolation,  // the requested time is outside of the cached window
+    NotConnected,   // the frames are not part of the same tree
+    Busy,           // writers kept overwriting what we were reading
+};
+
+inline const char *to_string(TfError e)
+{
+    switch (e) {
+        case TfError::None:
+            return "none";
+        case TfError::UnknownFrame:
+            return "unknown frame";
+        case TfError::NoData:
+            return "no data";
+        case TfError::Extrapolation:
+            return "extrapolation";
+        case TfError::NotConnected:
+            return "frames are not connected";
+        case TfError::Busy:
+            return "busy";
+    }
+    return "unknown";
+}
+
+class TfBuffer {
+   public:
+    // `cache_size` is the number of transforms kept per frame (e.g. 10s of a 100 Hz /tf)
+    explicit TfBuffer(size_t max_frames = 1024, size_t cache_size = 1024)
+        : _frames(max_frames), _cache_size(cache_size), _caches(new std::atomic<FrameCache *>[max_frames])
+    {
+        for (size_t i = 0; i < max_frames; i++) {
+            _caches[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~TfBuffer()
+    {
+        for (size_t i = 0; i < _frames.capacity(); i++) {
+            delete _caches[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    TfBuffer(const TfBuffer &) = delete;
+    TfBuffer &operator=(const TfBuffer &) = delete;
+
+    FrameRegistry &frames() { return _frames; }
+    const FrameRegistry &frames() const { return _frames; }
+
+    // Record the transform from `parent` to `child` at `stamp_ns`.
+    // Transforms older than the latest one of the same frame are ignored, as they would break the
+    // ordering of its ring. Returns false if the transform was ignored.
+    bool set_transform(FrameId parent, FrameId child, int64_t stamp_ns, const Transform &tf, bool is_static)
+    {
+        if (parent == child || parent >= _frames.capacity() || child >= _frames.capacity()) {
+            return false;
+        }
+        FrameCache &cache = cache_for(child);
+        std::lock_guard<std::mutex> lock(cache.writer);
+        if (!cache.insert(parent, stamp_ns, tf, is_static)) {
+            _ignored.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    bool set_transform(std::string_view parent, std::string_view child, int64_t stamp_ns, const Transform &tf,
+                       bool is_static)
+    {
+        return set_transform(_frames.intern(parent), _frames.intern(child), stamp_ns, tf, is_static);
+    }
+
+    // The transform mapping points of `source` into `target` at `time_ns`.
+    // A time of 0 means the latest time at which the whole chain is known, as in tf2.
+    std::optional<Transform> lookup(FrameId target, FrameId source, int64_t time_ns, TfError *error = nullptr) const
+    {
+        TfError e = TfError::Busy;
+        // Only retry a bounded number of times: if writers are that fast, the data is too volatile anyway
+        for (int attempt = 0; attempt < 16 && e == TfError::Busy; attempt++) {
+            auto result = try_lookup(target, source, time_ns, e);
+            if (result.has_value()) {
+                if (error != nullptr) {
+                    *error = TfError::None;
+                }
+                return result;
+            }
+        }
+        if (error != nullptr) {
+            *error = e;
+        }
+        return std::nullopt;
+    }
+
+    std::optional<Transform> lookup(std::string_view target, std::string_view source, int64_t time_ns,
+                                    TfError *error = nullptr) const
+    {
+        FrameId t = _frames.find(target);
+        FrameId s = _frames.find(source);
+        if (t == TF_INVALID_FRAME || s == TF_INVALID_FRAME) {
+            if (error != nullptr) {
+                *error = TfError::UnknownFrame;
+            }
+            return std::nullopt;
+        }
+        return lookup(t, s, time_ns, error);
+    }
+
+    // The parent of `frame` according to its latest transform
+    FrameId parent_of(FrameId frame) const
+    {
+        const FrameCache *cache = cache_of(frame);
+        Sample s;
+        if (cache == nullptr || cache->latest(s) != ReadStatus::Ok) {
+            return TF_INVALID_FRAME;
+        }
+        return s.parent;
+    }
+
+    // The number of transforms ignored because they were older than the latest one of their frame
+    uint64_t ignored() const { return _ignored.load(std::memory_order_relaxed); }
+
+   private:
+    struct Sample {
+        int64_t stamp_ns;
+        Transform tf;
+        FrameId parent;
+        uint32_t is_static;
+        // The position of the sample in the stream of writes, used to detect that a slot was recycled
+        uint64_t index;
+    };
+    static_assert(sizeof(Sample) % sizeof(uint64_t) == 0, "Sample must be made of whole words");
+    static constexpr size_t SAMPLE_WORDS = sizeof(Sample) / sizeof(uint64_t);
+
+    enum class ReadStatus { Ok, Retry, Empty };
+
+    // A slot protected by a sequence number: odd while being written.
+    // The payload is stored as atomic words so that concurrent reads are well-defined.
+    struct Slot {
+        std::atomic<uint64_t> seq{0};
+        std::array<std::atomic<uint64_t>, SAMPLE_WORDS> words{};
+
+        void store(const Sample &s)
+        {
+            std::array<uint64_t, SAMPLE_WORDS> raw;
+            std::memcpy(raw.data(), &s, sizeof(Sample));
+            uint64_t seq0 = seq.load(std::memory_order_relaxed);
+            seq.store(seq0 + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for (size_t i = 0; i < SAMPLE_WORDS; i++) {
+                words[i].store(raw[i], std::memory_order_relaxed);
+            }
+            seq.store(seq0 + 2, std::memory_order_release);
+        }
+
+        bool load(Sample &s) const
+        {
+            uint64_t seq0 = seq.load(std::memory_order_acquire);
+            if (seq0 & 1) {
+                return false;
+            }
+            std::array<uint64_t, SAMPLE_WORDS> raw;
+            for (size_t i = 0; i < SAMPLE_WORDS; i++) {
+                raw[i] = words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq.load(std::memory_order_relaxed) != seq0) {
+                return false;
+            }
+            std::memcpy(static_cast<void *>(&s), raw.data(), sizeof(Sample));
+            return true;
+        }
+    };
+
+    // The transforms of one frame to its parent, in a ring ordered by time
+    struct FrameCache {
+        explicit FrameCache(size_t capacity) : capacity(capacity), slots(new Slot[capacity]) {}
+
+        const size_t capacity;
+        std::unique_ptr<Slot[]> slots;
+        // The number of samples ever written, the latest one being at (count - 1) % capacity
+        std::atomic<uint64_t> count{0};
+        // Only serializes writers, readers never take it
+        std::mutex writer;
+        int64_t latest_stamp = INT64_MIN;
+
+        bool insert(FrameId parent, int64_t stamp_ns, const Transform &tf, bool is_static)
+        {
+            uint64_t n = count.load(std::memory_order_relaxed);
+            if (is_static) {
+                // Static transforms are valid at any time: only the latest one matters
+                if (n > 0) {
+                    n--;
+                }
+            } else if (stamp_ns < latest_stamp) {
+                return false;
+            }
+            latest_stamp = stamp_ns;
+            slots[n % capacity].store(Sample{stamp_ns, tf, parent, is_static ? 1u : 0u, n});
+            count.store(n + 1, std::memory_order_release);
+            return true;
+        }
+
+        ReadStatus read(uint64_t index, Sample &s) const
+        {
+            if (!slots[index % capacity].load(s) || s.index != index) {
+                return ReadStatus::Retry;
+            }
+            return ReadStatus::Ok;
+        }
+
+        ReadStatus latest(Sample &s) const
+        {
+            uint64_t n = count.load(std::memory_order_acquire);
+            if (n == 0) {
+                return ReadStatus::Empty;
+            }
+            return read(n - 1, s);
+        }
+
+        // Find the transform at `time_ns`, interpolating between the samples around it
+        ReadStatus at(int64_t time_ns, Sample &out, TfError &error) const
+        {
+            uint64_t n = count.load(std::memory_order_acquire);
+            if (n == 0) {
+                error = TfError::NoData;
+                return ReadStatus::Empty;
+            }
+            Sample newest;
+            if (read(n - 1, newest) != ReadStatus::Ok) {
+                return ReadStatus::Retry;
+            }
+            if (newest.is_static || time_ns == newest.stamp_ns) {
+                out = newest;
+                return ReadStatus::Ok;
+            }
+            if (time_ns > newest.stamp_ns) {
+                error = TfError::Extrapolation;
+                return ReadStatus::Empty;
+            }
+            // Binary search of the first sample at or after time_ns, among the ones still in the ring
+            uint64_t lo = n > capacity ? n - capacity : 0;
+            uint64_t hi = n - 1;
+            Sample s;
+            while (lo < hi) {
+                uint64_t mid = lo + (hi - lo) / 2;
+                if (read(mid, s) != ReadStatus::Ok) {
+                    return ReadStatus::Retry;
+                }
+                if (s.stamp_ns < time_ns) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            Sample after;
+            if (read(lo, after) != ReadStatus::Ok) {
+                return ReadStatus::Retry;
+            }
+            if (after.stamp_ns == time_ns) {
+                out = after;
+                return ReadStatus::Ok;
+            }
+            uint64_t oldest = n > capacity ? n - capacity : 0;
+            if (lo == oldest) {
+                error = TfError::Extrapolation;
+                return ReadStatus::Empty;
+            }
+            Sample before;
+            if (read(lo - 1, before) != ReadStatus::Ok) {
+                return ReadStatus::Retry;
+            }
+            double t = double(time_ns - before.stamp_ns) / double(after.stamp_ns - before.stamp_ns);
+            out = after;
+            out.tf = interpolate(before.tf, after.tf, t);
+            // Use the parent that was valid at that time
+            out.parent = t < 0.5 ? before.parent : after.parent;
+            out.stamp_ns = time_ns;
+            return ReadStatus::Ok;
+        }
+    };
+
+    FrameCache &cache_for(FrameId frame)
+    {
+        FrameCache *cache = _caches[frame].load(std::memory_order_acquire);
+        if (cache != nullptr) {
+            return *cache;
+        }
+        std::lock_guard<std::mutex> lock(_alloc_mutex);
+        cache = _caches[frame].load(std::memory_order_acquire);
+        if (cache == nullptr) {
+            cache = new FrameCache(_cache_size);
+            _caches[frame].store(cache, std::memory_order_release);
+        }
+        return *cache;
+    }
+
+    const FrameCache *cache_of(FrameId frame) const
+    {
+        if (frame >= _frames.capacity()) {
+            return nullptr;
+        }
+        return _caches[frame].load(std::memory_order_acquire);
+    }
+
+    // Walk up from `frame` at `time_ns`, filling `chain` with the frames met and the transform
+    // from each of them to `frame`. Returns the length of the chain.
+    size_t walk(FrameId frame, int64_t time_ns, std::array<FrameId, TF_MAX_CHAIN_DEPTH> &chain,
+                std::array<Transform, TF_MAX_CHAIN_DEPTH> &to_frame, TfError &error) const
+    {
+        size_t len = 0;
+        chain[len] = frame;
+        to_frame[len] = Transform{};
+        len++;
+        while (len < TF_MAX_CHAIN_DEPTH) {
+            const FrameCache *cache = cache_of(chain[len - 1]);
+            if (cache == nullptr) {
+                // The root of the tree
+                return len;
+            }
+            Sample s;
+            TfError e = TfError::None;
+            ReadStatus status = cache->at(time_ns, s, e);
+            if (status == ReadStatus::Retry) {
+                error = TfError::Busy;
+                return 0;
+            }
+            if (status == ReadStatus::Empty) {
+                error = e;
+                return 0;
+            }
+            chain[len] = s.parent;
+            to_frame[len] = s.tf * to_frame[len - 1];
+            len++;
+        }
+        error = TfError::NotConnected;
+        return 0;
+    }
+
+    // The latest time at which all the non-static transforms up from `frame` are known
+    bool latest_common_time(FrameId frame, int64_t &time_ns, TfError &error) const
+    {
+        for (size_t depth = 0; depth < TF_MAX_CHAIN_DEPTH; depth++) {
+            const FrameCache *cache = cache_of(frame);
+            if (cache == nullptr) {
+                return true;
+            }
+            Sample s;
+            ReadStatus status = cache->latest(s);
+            if (status == ReadStatus::Retry) {
+                error = TfError::Busy;
+                return false;
+            }
+            if (status == ReadStatus::Empty) {
+                error = TfError::NoData;
+                return false;
+            }
+            if (!s.is_static && s.stamp_ns < time_ns) {
+                time_ns = s.stamp_ns;
+            }
+            frame = s.parent;
+        }
+        error = TfError::NotConnected;
+        return false;
+    }
+
+    std::optional<Transform> try_lookup(FrameId target, FrameId source, int64_t time_ns, TfError &error) const
+    {
+        if (target >= _frames.capacity() || source >= _frames.capacity()) {
+            error = TfError::UnknownFrame;
+            return std::nullopt;
+        }
+        if (target == source) {
+            return Transform{};
+        }
+        if (time_ns == 0) {
+            time_ns = INT64_MAX;
+            if (!latest_common_time(source, time_ns, error) || !latest_common_time(target, time_ns, error)) {
+                return std::nullopt;
+            }
+            if (time_ns == INT64_MAX) {
+                // Only static transforms
+                time_ns = 0;
+            }
+        }
+
+        std::array<FrameId, TF_MAX_CHAIN_DEPTH> source_chain, target_chain;
+        std::array<Transform, TF_MAX_CHAIN_DEPTH> to_source, to_target;
+        size_t source_len = walk(source, time_ns, source_chain, to_source, error);
+        if (source_len == 0) {
+            return std::nullopt;
+        }
+        size_t target_len = walk(target, time_ns, target_chain, to_target, error);
+        if (target_len == 0) {
+            return std::nullopt;
+        }
+        // Find the closest common ancestor; chains are short, a quadratic search is fine
+        for (size_t t = 0; t < target_len; t++) {
+            for (size_t s = 0; s < source_len; s++) {
+                if (target_chain[t] == source_chain[s]) {
+                    // to_target[t] maps target into the ancestor, to_source[s] maps source into it
+                    return to_target[t].inverse() * to_source[s];
+                }
+            }
+        }
+        error = TfError::NotConnected;
+        return std::nullopt;
+    }
+
+    FrameRegistry _frames;
+    const size_t _cache_size;
+    std::unique_ptr<std::atomic<FrameCache *>[]> _caches;
+    std::mutex _alloc_mutex;
+    std::atomic<uint64_t> _ignored{0};
+};
+
+// Feed all the transforms of an idlcxx tf2_msgs::msg::TFMessage into `buffer`
+template <typename TFMessage>
+void set_transforms(TfBuffer &buffer, const TFMessage &msg, bool is_static)
+{
+    for (const auto &t : msg.transforms()) {
+        const auto &stamp = t.header().stamp();
+        const auto &tr = t.transform().translation();
+        const auto &rot = t.transform().rotation();
+        Transform tf{{tr.x(), tr.y(), tr.z()}, {rot.x(), rot.y(), rot.z(), rot.w()}};
+        int64_t stamp_ns = int64_t(stamp.sec()) * 1000000000 + stamp.nanosec();
+        buffer.set_transform(t.header().frame_id(), t.child_frame_id(), stamp_ns, tf, is_static);
+    }
+}
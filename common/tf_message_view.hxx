@@ -0,0 +1,96 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "cdr_view.hxx"
+#include "point_cloud_view.hxx"
+#include "tf_buffer.hxx"
+
+// In-place decoding of tf2_msgs/msg/TFMessage (see common/idl/TFMessage.idl).
+// The idlcxx-generated type allocates a vector and two strings per transform
+// for every sample; here the frame names are views into the payload, interned
+// to FrameId, and the list of transforms is reused from one sample to the next.
+
+struct TransformStampedView {
+    HeaderView header;
+    std::string_view child_frame_id;
+    // The interned `header.frame_id` and `child_frame_id`
+    FrameId parent = TF_INVALID_FRAME;
+    FrameId child = TF_INVALID_FRAME;
+    Transform transform;
+
+    int64_t stamp_ns() const { return int64_t(header.stamp.sec) * 1000000000 + header.stamp.nanosec; }
+};
+
+// Each TransformStamped takes at least 8 (stamp) + 2 * 5 (strings) + 7 * 8 (transform) bytes
+#define TF_TRANSFORM_MIN_CDR_SIZE 74
+
+// Decodes TFMessages into a list of transforms owned by the decoder.
+// Keep one decoder per worker thread: once the list has grown to the largest
+// message and all the frame names are registered, decoding doesn't allocate.
+class TfMessageDecoder {
+   public:
+    explicit TfMessageDecoder(FrameRegistry &frames) : _frames(frames) {}
+
+    TfMessageDecoder(const TfMessageDecoder &) = delete;
+    TfMessageDecoder &operator=(const TfMessageDecoder &) = delete;
+
+    // Decode a CDR payload, including its 4-byte encapsulation header.
+    // The views are valid until the next call, and as long as the payload is alive.
+    const std::vector<TransformStampedView> &decode(const uint8_t *payload, size_t len)
+    {
+        CdrReader reader(payload, len);
+        uint32_t nb_transforms = reader.read_sequence_length(TF_TRANSFORM_MIN_CDR_SIZE);
+        // Shrinking keeps the capacity reached by the largest message
+        _transforms.resize(nb_transforms);
+        for (auto &t : _transforms) {
+            t.header.stamp.sec = reader.read_i32();
+            t.header.stamp.nanosec = reader.read_u32();
+            t.header.frame_id = reader.read_string();
+            t.child_frame_id = reader.read_string();
+            auto &tr = t.transform.translation;
+            tr.x = reader.read_f64();
+            tr.y = reader.read_f64();
+            tr.z = reader.read_f64();
+            auto &rot = t.transform.rotation;
+            rot.x = reader.read_f64();
+            rot.y = reader.read_f64();
+            rot.z = reader.read_f64();
+            rot.w = reader.read_f64();
+            // Only the first occurrence of a frame name allocates
+            t.parent = _frames.intern(t.header.frame_id);
+            t.child = _frames.intern(t.child_frame_id);
+        }
+        return _transforms;
+    }
+
+    const std::vector<TransformStampedView> &decode(ByteSpan payload) { return decode(payload.data, payload.size); }
+
+    const std::vector<TransformStampedView> &transforms() const { return _transforms; }
+
+   private:
+    FrameRegistry &_frames;
+    std::vector<TransformStampedView> _transforms;
+};
+
+// Feed the transforms decoded by a TfMessageDecoder into `buffer`, which must own the registry they were interned in
+inline void set_transforms(TfBuffer &buffer, const std::vector<TransformStampedView> &transforms, bool is_static)
+{
+    for (const auto &t : transforms) {
+        buffer.set_transform(t.parent, t.child, t.stamp_ns(), t.transform, is_static);
+    }
+}
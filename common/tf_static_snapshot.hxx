@@ -0,0 +1,378 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cdr_view.hxx"
+#include "tf_buffer.hxx"
+#include "tf_message_view.hxx"
+
+// A snapshot of the static transforms on disk, so that a restarted subscriber
+// has its static tree at once instead of waiting for the history of every
+// /tf_static publisher. The file is little endian and made of fixed-size
+// records followed by the frame names, so that it is read in place from a
+// read-only mapping:
+//
+//   header:  magic "ZTFSNAP\0" | u32 version | u32 nb_records | u64 names_size | u64 checksum
+//   records: i64 stamp_ns | f64 x, y, z | f64 qx, qy, qz, qw | u32 parent offset | u32 child offset
+//            | u16 parent length | u16 child length | u32 reserved
+//   names:   the frame names, referenced by offset into this table
+//
+// The checksum is the FNV-1a of everything after the header. A new snapshot is
+// written next to the old one and renamed over it, so that a crash never
+// leaves a truncated file behind.
+
+#define TF_SNAPSHOT_MAGIC "ZTFSNAP"
+#define TF_SNAPSHOT_VERSION 1
+
+// The seconds after the load within which the publishers of the loaded transforms are expected to send them again
+#define TF_SNAPSHOT_GRACE_PERIOD 60
+
+struct TfSnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t nb_records;
+    uint64_t names_size;
+    uint64_t checksum;
+};
+
+struct TfSnapshotRecord {
+    int64_t stamp_ns;
+    double translation[3];
+    double rotation[4];
+    uint32_t parent_offset;
+    uint32_t child_offset;
+    uint16_t parent_len;
+    uint16_t child_len;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(TfSnapshotHeader) == 32, "TfSnapshotHeader must have no padding");
+static_assert(sizeof(TfSnapshotRecord) == 80, "TfSnapshotRecord must have no padding");
+
+inline uint64_t tf_snapshot_checksum(const uint8_t *data, size_t len)
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ data[i]) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+// The last-known static transforms, kept in sync with what /tf_static delivers.
+// Transforms loaded from the snapshot are replaced as soon as a live publisher
+// sends the same child frame. Those not confirmed within the grace period stay
+// in memory, as static transforms are never removed from a tf2 buffer either,
+// but are left out of the next snapshots: a publisher gone for good doesn't
+// haunt every restart.
+class TfStaticSnapshot {
+   public:
+    explicit TfStaticSnapshot(std::string path,
+                              std::chrono::seconds grace_period = std::chrono::seconds(TF_SNAPSHOT_GRACE_PERIOD))
+        : _path(std::move(path)), _grace_period(grace_period)
+    {
+    }
+
+    TfStaticSnapshot(const TfStaticSnapshot &) = delete;
+    TfStaticSnapshot &operator=(const TfStaticSnapshot &) = delete;
+
+    const std::string &path() const { return _path; }
+
+    // Load the snapshot into `buffer`, before the session is opened.
+    // Returns the number of transforms loaded, 0 if there's no snapshot yet.
+    size_t load(TfBuffer &buffer)
+    {
+        int fd = ::open(_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            if (errno == ENOENT) {
+                return 0;
+            }
+            throw std::runtime_error("Failed to open " + _path + ": " + std::strerror(errno));
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Failed to stat " + _path + ": " + std::strerror(errno));
+        }
+        size_t size = size_t(st.st_size);
+        if (size < sizeof(TfSnapshotHeader)) {
+            ::close(fd);
+            throw std::runtime_error(_path + " is not a tf_static snapshot");
+        }
+        void *data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            throw std::runtime_error("Failed to map " + _path + ": " + std::strerror(errno));
+        }
+        size_t nb_loaded = 0;
+        try {
+            nb_loaded = load(static_cast<const uint8_t *>(data), size, buffer);
+        } catch (...) {
+            ::munmap(data, size);
+            throw;
+        }
+        ::munmap(data, size);
+        return nb_loaded;
+    }
+
+    // Called with the transforms of each /tf_static message
+    void update(const std::vector<TransformStampedView> &transforms)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (const auto &t : transforms) {
+            auto it = _transforms.find(t.child_frame_id);
+            if (it == _transforms.end()) {
+                it = _transforms.emplace(std::string(t.child_frame_id), Entry{}).first;
+            } else if (!it->second.live) {
+                _nb_confirmed++;
+            }
+            Entry &e = it->second;
+            bool changed = e.parent != t.header.frame_id || !same(e.transform, t.transform);
+            e.parent.assign(t.header.frame_id);
+            e.stamp_ns = t.stamp_ns();
+            e.transform = t.transform;
+            e.live = true;
+            // A publisher restamping the same transform doesn't need a new snapshot
+            if (changed) {
+                _version++;
+            }
+        }
+    }
+
+    // Write the snapshot if the transforms changed since the last time.
+    // Called periodically, so that the burst of history of a restart is written once.
+    bool save_if_changed()
+    {
+        std::vector<uint8_t> file;
+        uint64_t version;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_expired && std::chrono::steady_clock::now() - _loaded_at >= _grace_period) {
+                _expired = true;
+                // The unconfirmed transforms are dropped from the file
+                if (_nb_confirmed < _nb_loaded) {
+                    _version++;
+                }
+            }
+            if (_version == _saved_version) {
+                return false;
+            }
+            serialize(file);
+            version = _version;
+        }
+        write_atomically(file);
+        // Only now: a failed write is retried on the next call
+        std::lock_guard<std::mutex> lock(_mutex);
+        _saved_version = std::max(_saved_version, version);
+        return true;
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _transforms.size();
+    }
+
+    // The number of loaded transforms that live publishers have sent again
+    size_t confirmed() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _nb_confirmed;
+    }
+
+   private:
+    struct Entry {
+        std::string parent;
+        int64_t stamp_ns = 0;
+        Transform transform;
+        // Received from a publisher, rather than loaded from the snapshot
+        bool live = false;
+    };
+
+    static bool same(const Transform &a, const Transform &b)
+    {
+        return std::memcmp(&a, &b, sizeof(Transform)) == 0;
+    }
+
+    size_t load(const uint8_t *data, size_t size, TfBuffer &buffer)
+    {
+        if (!host_is_little_endian()) {
+            throw std::runtime_error("tf_static snapshots are only supported on little endian hosts");
+        }
+        TfSnapshotHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, TF_SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+            throw std::runtime_error(_path + " is not a tf_static snapshot");
+        }
+        if (header.version != TF_SNAPSHOT_VERSION) {
+            throw std::runtime_error(_path + " has an unsupported version " + std::to_string(header.version));
+        }
+        size_t records_size = size_t(header.nb_records) * sizeof(TfSnapshotRecord);
+        if (size - sizeof(header) < records_size || size - sizeof(header) - records_size != header.names_size) {
+            throw std::runtime_error(_path + " is truncated");
+        }
+        if (tf_snapshot_checksum(data + sizeof(header), size - sizeof(header)) != header.checksum) {
+            throw std::runtime_error(_path + " is corrupted");
+        }
+        const uint8_t *records = data + sizeof(header);
+        std::string_view names(reinterpret_cast<const char *>(records + records_size), header.names_size);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (uint32_t i = 0; i < header.nb_records; i++) {
+            TfSnapshotRecord r;
+            std::memcpy(&r, records + i * sizeof(TfSnapshotRecord), sizeof(r));
+            if (size_t(r.parent_offset) + r.parent_len > names.size() ||
+                size_t(r.child_offset) + r.child_len > names.size()) {
+                throw std::runtime_error(_path + " has a frame name out of bounds");
+            }
+            auto parent = names.substr(r.parent_offset, r.parent_len);
+            auto child = names.substr(r.child_offset, r.child_len);
+            Transform tf{{r.translation[0], r.translation[1], r.translation[2]},
+                         {r.rotation[0], r.rotation[1], r.rotation[2], r.rotation[3]}};
+            buffer.set_transform(parent, child, r.stamp_ns, tf, true);
+            if (_transforms.emplace(std::string(child), Entry{std::string(parent), r.stamp_ns, tf, false}).second) {
+                _nb_loaded++;
+            }
+        }
+        _loaded_at = std::chrono::steady_clock::now();
+        return header.nb_records;
+    }
+
+    void serialize(std::vector<uint8_t> &file) const
+    {
+        std::string names;
+        std::vector<TfSnapshotRecord> records;
+        records.reserve(_transforms.size());
+        for (const auto &[child, e] : _transforms) {
+            if (e.parent.size() > UINT16_MAX || child.size() > UINT16_MAX) {
+                continue;
+            }
+            if (!e.live && _expired) {
+                continue;
+            }
+            TfSnapshotRecord r{};
+            r.stamp_ns = e.stamp_ns;
+            r.translation[0] = e.transform.translation.x;
+            r.translation[1] = e.transform.translation.y;
+            r.translation[2] = e.transform.translation.z;
+            r.rotation[0] = e.transform.rotation.x;
+            r.rotation[1] = e.transform.rotation.y;
+            r.rotation[2] = e.transform.rotation.z;
+            r.rotation[3] = e.transform.rotation.w;
+            r.parent_offset = uint32_t(names.size());
+            r.parent_len = uint16_t(e.parent.size());
+            names += e.parent;
+            r.child_offset = uint32_t(names.size());
+            r.child_len = uint16_t(child.size());
+            names += child;
+            records.push_back(r);
+        }
+
+        size_t records_size = records.size() * sizeof(TfSnapshotRecord);
+        file.resize(sizeof(TfSnapshotHeader) + records_size + names.size());
+        if (!records.empty()) {
+            std::memcpy(file.data() + sizeof(TfSnapshotHeader), records.data(), records_size);
+        }
+        std::memcpy(file.data() + sizeof(TfSnapshotHeader) + records_size, names.data(), names.size());
+
+        TfSnapshotHeader header{};
+        std::memcpy(header.magic, TF_SNAPSHOT_MAGIC, sizeof(TF_SNAPSHOT_MAGIC));
+        header.version = TF_SNAPSHOT_VERSION;
+        header.nb_records = uint32_t(records.size());
+        header.names_size = names.size();
+        header.checksum = tf_snapshot_checksum(file.data() + sizeof(header), file.size() - sizeof(header));
+        std::memcpy(file.data(), &header, sizeof(header));
+    }
+
+    // Write to a temporary file, flush it, rename it over the snapshot and flush the directory, so that the
+    // rename survives a power loss. Before the rename, a failure removes the temporary file and leaves the
+    // previous snapshot as is.
+    void write_atomically(const std::vector<uint8_t> &file) const
+    {
+        std::string tmp_path = _path + ".tmp";
+        int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open " + tmp_path + ": " + std::strerror(errno));
+        }
+        auto fail = [&tmp_path](const char *what, int err) {
+            ::unlink(tmp_path.c_str());
+            throw std::runtime_error(std::string("Failed to ") + what + " " + tmp_path + ": " + std::strerror(err));
+        };
+        size_t written = 0;
+        while (written < file.size()) {
+            ssize_t n = ::write(fd, file.data() + written, file.size() - written);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                int err = errno;
+                ::close(fd);
+                fail("write", err);
+            }
+            written += size_t(n);
+        }
+        if (::fsync(fd) != 0) {
+            int err = errno;
+            ::close(fd);
+            fail("flush", err);
+        }
+        if (::close(fd) != 0) {
+            fail("close", errno);
+        }
+        if (::rename(tmp_path.c_str(), _path.c_str()) != 0) {
+            fail("rename", errno);
+        }
+
+        size_t slash = _path.rfind('/');
+        std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : _path.substr(0, slash);
+        int dir_fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir_fd < 0) {
+            throw std::runtime_error("Failed to open " + dir + ": " + std::strerror(errno));
+        }
+        if (::fsync(dir_fd) != 0) {
+            int err = errno;
+            ::close(dir_fd);
+            throw std::runtime_error("Failed to flush " + dir + ": " + std::strerror(err));
+        }
+        ::close(dir_fd);
+    }
+
+    const std::string _path;
+    mutable std::mutex _mutex;
+    // By child frame: a frame has a single parent
+    std::map<std::string, Entry, std::less<>> _transforms;
+    uint64_t _version = 0;
+    uint64_t _saved_version = 0;
+    size_t _nb_loaded = 0;
+    size_t _nb_confirmed = 0;
+    const std::chrono::seconds _grace_period;
+    std::chrono::steady_clock::time_point _loaded_at = std::chrono::steady_clock::now();
+    bool _expired = false;
+};
@@ -0,0 +1,408 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "latency_histogram.hxx"
+
+// The wall clock time in nanoseconds, comparable with the header stamps of ROS messages
+inline int64_t system_time_ns()
+{
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+// A builtin_interfaces/Time stamp in nanoseconds
+inline int64_t stamp_ns(int32_t sec, uint32_t nanosec) { return int64_t(sec) * 1000000000 + nanosec; }
+
+// An item with the time it was received, before it's queued to the workers
+template <typename T>
+struct Timed {
+    T value;
+    int64_t received_ns;
+};
+
+// A histogram recorded by one thread and drained concurrently by the reporter.
+// Both sides only use atomic increments/decrements on the buckets: no lock on
+// the hot path, and no count is lost while draining. The buckets are allocated
+// by the first record, and 32 bits are plenty between two drains.
+class ConcurrentHistogram {
+   public:
+    ConcurrentHistogram() = default;
+    ~ConcurrentHistogram() { delete[] _counts.load(std::memory_order_relaxed); }
+
+    ConcurrentHistogram(const ConcurrentHistogram &) = delete;
+    ConcurrentHistogram &operator=(const ConcurrentHistogram &) = delete;
+
+    void record(uint64_t v)
+    {
+        std::atomic<uint32_t> *counts = _counts.load(std::memory_order_relaxed);
+        if (counts == nullptr) {
+            // Only the recording thread allocates: publishing the buckets is enough
+            counts = new std::atomic<uint32_t>[CompactHistogram::NB_BUCKETS];
+            for (size_t i = 0; i < CompactHistogram::NB_BUCKETS; i++) {
+                counts[i].store(0, std::memory_order_relaxed);
+            }
+            _counts.store(counts, std::memory_order_release);
+        }
+        counts[CompactHistogram::bucket_of(v)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Move the recorded values into `into`. Values are rounded to the upper bound of their bucket.
+    void drain(CompactHistogram &into)
+    {
+        std::atomic<uint32_t> *counts = _counts.load(std::memory_order_acquire);
+        if (counts == nullptr) {
+            return;
+        }
+        for (size_t i = 0; i < CompactHistogram::NB_BUCKETS; i++) {
+            uint32_t n = counts[i].load(std::memory_order_relaxed);
+            if (n != 0) {
+                counts[i].fetch_sub(n, std::memory_order_relaxed);
+                into.record(CompactHistogram::upper_bound_of(i), n);
+            }
+        }
+    }
+
+   private:
+    std::atomic<std::atomic<uint32_t> *> _counts{nullptr};
+};
+
+// The statistics of a topic over a period of time
+struct TopicStats {
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+    // Payloads that could not be decoded
+    uint64_t errors = 0;
+    // Samples dropped by the topic queue when the workers don't keep up
+    uint64_t dropped = 0;
+    // Samples lost before reaching us, as detected by the advanced subscriber
+    uint64_t missed = 0;
+    // From the header stamp to the reception by Zenoh: publisher, bridge and network
+    CompactHistogram latency_ns;
+    // From the reception by Zenoh to the start of the processing
+    CompactHistogram queue_ns;
+    // Deserialization of the payload
+    CompactHistogram decode_ns;
+
+    void merge(const TopicStats &other)
+    {
+        messages += other.messages;
+        bytes += other.bytes;
+        errors += other.errors;
+        dropped += other.dropped;
+        missed += other.missed;
+        latency_ns.merge(other.latency_ns);
+        queue_ns.merge(other.queue_ns);
+        decode_ns.merge(other.decode_ns);
+    }
+
+    // Keeps the histograms allocated
+    void reset()
+    {
+        messages = bytes = errors = dropped = missed = 0;
+        latency_ns.reset();
+        queue_ns.reset();
+        decode_ns.reset();
+    }
+};
+
+// The percentiles of a histogram, kept instead of its buckets
+struct HistogramSummary {
+    HistogramSummary() = default;
+    explicit HistogramSummary(const CompactHistogram &h)
+        : count(h.count()), min(h.min()), mean(uint64_t(h.mean())), p50(h.percentile(50)), p90(h.percentile(90)),
+          p99(h.percentile(99)), p999(h.percentile(99.9)), max(h.max())
+    {
+    }
+
+    uint64_t count = 0;
+    uint64_t min = 0;
+    uint64_t mean = 0;
+    uint64_t p50 = 0;
+    uint64_t p90 = 0;
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+    uint64_t max = 0;
+};
+
+// The statistics of a topic, without the buckets of the histograms
+struct TopicSummary {
+    TopicSummary() = default;
+    explicit TopicSummary(const TopicStats &s)
+        : messages(s.messages), bytes(s.bytes), errors(s.errors), dropped(s.dropped), missed(s.missed),
+          latency_ns(s.latency_ns), queue_ns(s.queue_ns), decode_ns(s.decode_ns)
+    {
+    }
+
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+    uint64_t errors = 0;
+    uint64_t dropped = 0;
+    uint64_t missed = 0;
+    HistogramSummary latency_ns;
+    HistogramSummary queue_ns;
+    HistogramSummary decode_ns;
+};
+
+// The instrumentation of one subscription. Each recording thread gets its own
+// shard, so that the workers never contend with each other; the shards are
+// merged when the statistics are collected.
+class TopicMetrics {
+   public:
+    explicit TopicMetrics(std::string name) : _id(next_id()), _name(std::move(name)) {}
+
+    TopicMetrics(const TopicMetrics &) = delete;
+    TopicMetrics &operator=(const TopicMetrics &) = delete;
+
+    const std::string &name() const { return _name; }
+
+    // Count the drops of the queue in front of the workers, e.g. a Pipeline
+    template <typename Queue>
+    void track_queue(const Queue &queue)
+    {
+        _queue_dropped = [&queue]() { return queue.dropped(); };
+    }
+
+    // Record a decoded message. `latency_ns` is unknown when the message carries no stamp.
+    void record(size_t bytes, int64_t queue_ns, int64_t decode_ns, std::optional<int64_t> latency_ns)
+    {
+        auto &s = shard();
+        s.messages.fetch_add(1, std::memory_order_relaxed);
+        s.bytes.fetch_add(bytes, std::memory_order_relaxed);
+        s.queue_ns.record(clamp(queue_ns));
+        s.decode_ns.record(clamp(decode_ns));
+        if (latency_ns.has_value()) {
+            // Clocks of different hosts may be slightly off: never record a negative latency
+            s.latency_ns.record(clamp(*latency_ns));
+        }
+    }
+
+    void record_error(size_t bytes)
+    {
+        auto &s = shard();
+        s.messages.fetch_add(1, std::memory_order_relaxed);
+        s.bytes.fetch_add(bytes, std::memory_order_relaxed);
+        s.errors.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void record_missed(uint64_t nb) { _missed.fetch_add(nb, std::memory_order_relaxed); }
+
+    // Drops that aren't counted by the tracked queue
+    void record_dropped(uint64_t nb) { _dropped.fetch_add(nb, std::memory_order_relaxed); }
+
+    // The statistics since the previous call, into `stats` whose histograms are reused
+    void collect(TopicStats &stats)
+    {
+        stats.reset();
+        {
+            std::lock_guard<std::mutex> lock(_shards_mutex);
+            for (auto &s : _shards) {
+                stats.messages += drain(s->messages);
+                stats.bytes += drain(s->bytes);
+                stats.errors += drain(s->errors);
+                s->latency_ns.drain(stats.latency_ns);
+                s->queue_ns.drain(stats.queue_ns);
+                s->decode_ns.drain(stats.decode_ns);
+            }
+        }
+        stats.missed = drain(_missed);
+        stats.dropped = drain(_dropped);
+        if (_queue_dropped) {
+            uint64_t dropped = _queue_dropped();
+            stats.dropped += dropped - _last_dropped;
+            _last_dropped = dropped;
+        }
+    }
+
+   private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> messages{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> errors{0};
+        ConcurrentHistogram latency_ns;
+        ConcurrentHistogram queue_ns;
+        ConcurrentHistogram decode_ns;
+    };
+
+    static uint64_t next_id()
+    {
+        static std::atomic<uint64_t> id{0};
+        return id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static uint64_t clamp(int64_t v) { return v < 0 ? 0 : uint64_t(v); }
+
+    static uint64_t drain(std::atomic<uint64_t> &counter)
+    {
+        uint64_t n = counter.load(std::memory_order_relaxed);
+        counter.fetch_sub(n, std::memory_order_relaxed);
+        return n;
+    }
+
+    Shard &shard()
+    {
+        // With the discovery, the workers of a type record all its topics, possibly thousands of them
+        thread_local std::unordered_map<uint64_t, Shard *> shards;
+        auto it = shards.find(_id);
+        if (it != shards.end()) {
+            return *it->second;
+        }
+        std::lock_guard<std::mutex> lock(_shards_mutex);
+        _shards.push_back(std::make_unique<Shard>());
+        shards.emplace(_id, _shards.back().get());
+        return *_shards.back();
+    }
+
+    // Unique across the process, so that a thread never mistakes the shard of a destroyed topic for ours
+    uint64_t _id;
+    std::string _name;
+    std::mutex _shards_mutex;
+    std::vector<std::unique_ptr<Shard>> _shards;
+    std::atomic<uint64_t> _missed{0};
+    std::atomic<uint64_t> _dropped{0};
+    std::function<uint64_t()> _queue_dropped;
+    uint64_t _last_dropped = 0;
+};
+
+// The metrics of all the subscriptions of the process, collected periodically
+class MetricsRegistry {
+   public:
+    TopicMetrics &add(std::string name)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _topics.push_back(std::make_unique<Topic>(std::move(name)));
+        return _topics.back()->metrics;
+    }
+
+    // Once nothing records into them anymore, e.g. a topic whose publishers are gone
+    void remove(const TopicMetrics &metrics)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto it = _topics.begin(); it != _topics.end(); ++it) {
+            if (&(*it)->metrics == &metrics) {
+                _topics.erase(it);
+                return;
+            }
+        }
+    }
+
+    // The metrics of `name`, added the first time
+    TopicMetrics &get(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto &t : _topics) {
+            if (t->metrics.name() == name) {
+                return t->metrics;
+            }
+        }
+        _topics.push_back(std::make_unique<Topic>(name));
+        return _topics.back()->metrics;
+    }
+
+    // Collect the statistics of the period since the previous call, and return them as log lines
+    std::string report()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto now = std::chrono::steady_clock::now();
+        _period_s = std::chrono::duration<double>(now - _last_report).count();
+        _last_report = now;
+
+        // Only the totals keep their histograms: the period is collected into the same buffers for all the topics
+        std::ostringstream out;
+        for (auto &t : _topics) {
+            t->metrics.collect(_collected);
+            t->total.merge(_collected);
+            t->interval = TopicSummary(_collected);
+            out << format_line(t->metrics.name(), t->interval, _period_s) << "\n";
+        }
+        return out.str();
+    }
+
+    // The statistics of the last period and since the start, as JSON
+    std::string to_json(const std::string &zid) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::ostringstream out;
+        out << "{\"zid\":\"" << zid << "\",\"period_s\":" << _period_s << ",\"topics\":{";
+        for (size_t i = 0; i < _topics.size(); i++) {
+            const auto &t = *_topics[i];
+            out << (i > 0 ? "," : "") << "\"" << t.metrics.name() << "\":{\"interval\":";
+            write_json(out, t.interval);
+            out << ",\"total\":";
+            write_json(out, TopicSummary(t.total));
+            out << "}";
+        }
+        out << "}}";
+        return out.str();
+    }
+
+   private:
+    struct Topic {
+        explicit Topic(std::string name) : metrics(std::move(name)) {}
+        TopicMetrics metrics;
+        TopicSummary interval;
+        TopicStats total;
+    };
+
+    static std::string format_line(const std::string &name, const TopicSummary &s, double period_s)
+    {
+        char line[320];
+        std::snprintf(line, sizeof(line),
+                      ">> [Stats] %s: %.1f msg/s %.2f MB/s | latency p50 %.1f p99 %.1f max %.1f us"
+                      " | queue p99 %.1f us | decode p50 %.1f p99 %.1f us | dropped %llu missed %llu errors %llu",
+                      name.c_str(), double(s.messages) / period_s, double(s.bytes) / period_s / 1e6,
+                      double(s.latency_ns.p50) / 1e3, double(s.latency_ns.p99) / 1e3, double(s.latency_ns.max) / 1e3,
+                      double(s.queue_ns.p99) / 1e3, double(s.decode_ns.p50) / 1e3, double(s.decode_ns.p99) / 1e3,
+                      (unsigned long long)s.dropped,
+                      (unsigned long long)s.missed, (unsigned long long)s.errors);
+        return line;
+    }
+
+    static void write_json(std::ostringstream &out, const HistogramSummary &h)
+    {
+        out << "{\"count\":" << h.count << ",\"min\":" << h.min << ",\"mean\":" << h.mean << ",\"p50\":" << h.p50
+            << ",\"p90\":" << h.p90 << ",\"p99\":" << h.p99 << ",\"p999\":" << h.p999 << ",\"max\":" << h.max << "}";
+    }
+
+    static void write_json(std::ostringstream &out, const TopicSummary &s)
+    {
+        out << "{\"messages\":" << s.messages << ",\"bytes\":" << s.bytes << ",\"errors\":" << s.errors
+            << ",\"dropped\":" << s.dropped << ",\"missed\":" << s.missed << ",\"latency_ns\":";
+        write_json(out, s.latency_ns);
+        out << ",\"queue_ns\":";
+        write_json(out, s.queue_ns);
+        out << ",\"decode_ns\":";
+        write_json(out, s.decode_ns);
+        out << "}";
+    }
+
+    mutable std::mutex _mutex;
+    std::vector<std::unique_ptr<Topic>> _topics;
+    TopicStats _collected;
+    std::chrono::steady_clock::time_point _last_report = std::chrono::steady_clock::now();
+    double _period_s = 0.0;
+};
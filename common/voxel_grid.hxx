@@ -0,0 +1,218 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "point_cloud_fields.hxx"
+
+// Each voxel coordinate is packed on 21 bits of a 64-bit key
+#define VOXEL_COORD_BITS 21
+
+// The key of the voxel of side 1 / `inv_leaf` containing a point, or false if the point is not finite
+// or too far from the origin
+inline bool pack_voxel_key(float x, float y, float z, float inv_leaf, uint64_t &key)
+{
+    constexpr double offset = double(int64_t(1) << (VOXEL_COORD_BITS - 1));
+    // The range is checked in floating point: casting a value out of the int64 range is undefined.
+    // Written so that NaNs, e.g. from an infinite coordinate or leaf size, fail the check as well.
+    auto coord = [inv_leaf](float v, uint64_t &c) {
+        double f = std::floor(double(v) * double(inv_leaf));
+        if (!(f >= -offset && f < offset)) {
+            return false;
+        }
+        c = uint64_t(int64_t(f) + int64_t(offset));
+        return true;
+    };
+    uint64_t ix, iy, iz;
+    if (!coord(x, ix) || !coord(y, iy) || !coord(z, iz)) {
+        return false;
+    }
+    key = (ix << (2 * VOXEL_COORD_BITS)) | (iy << VOXEL_COORD_BITS) | iz;
+    return true;
+}
+
+// Voxel-grid downsampling: the points falling into the same cube of side
+// `leaf_size` are replaced by their centroid.
+// With more than one thread, the cloud is split in slices that are accumulated
+// in parallel, each thread in its own map, and the partial voxels are then
+// merged. The helper threads live as long as the grid. The default is a single
+// thread: the grids of the subscribers run on the pipeline workers, which
+// already process the clouds in parallel.
+class VoxelGrid {
+   public:
+    explicit VoxelGrid(float leaf_size, size_t nb_threads = 1)
+        : _inv_leaf(1.0f / leaf_size), _nb_threads(nb_threads == 0 ? 1 : nb_threads)
+    {
+        for (size_t i = 1; i < _nb_threads; i++) {
+            _helpers.emplace_back([this, i]() { help(i); });
+        }
+    }
+
+    VoxelGrid(const VoxelGrid &) = delete;
+    VoxelGrid &operator=(const VoxelGrid &) = delete;
+
+    ~VoxelGrid()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _start.notify_all();
+        for (auto &t : _helpers) {
+            t.join();
+        }
+    }
+
+    // Downsample `in` into `out`. Points with non-finite coordinates are skipped.
+    void downsample(const PointCloudSoA &in, PointCloudSoA &out)
+    {
+        const size_t n = in.size();
+        const bool with_intensity = !in.intensity.empty();
+
+        // Not worth spawning threads for small clouds
+        size_t nb_slices = std::min(_nb_threads, std::max<size_t>(1, n / MIN_POINTS_PER_THREAD));
+        _partials.resize(nb_slices);
+        for (auto &p : _partials) {
+            p.clear();
+        }
+
+        auto accumulate = [&](size_t slice) {
+            size_t begin = n * slice / nb_slices;
+            size_t end = n * (slice + 1) / nb_slices;
+            auto &voxels = _partials[slice];
+            for (size_t i = begin; i < end; i++) {
+                uint64_t key;
+                if (!pack_voxel_key(in.x[i], in.y[i], in.z[i], _inv_leaf, key)) {
+                    continue;
+                }
+                auto &v = voxels[key];
+                v.x += in.x[i];
+                v.y += in.y[i];
+                v.z += in.z[i];
+                if (with_intensity) {
+                    v.intensity += in.intensity[i];
+                }
+                v.count++;
+            }
+        };
+
+        if (nb_slices == 1) {
+            accumulate(0);
+        } else {
+            run_slices(nb_slices, accumulate);
+        }
+
+        // Merge the partial voxels into the first map
+        auto &merged = _partials[0];
+        for (size_t s = 1; s < nb_slices; s++) {
+            for (const auto &[key, v] : _partials[s]) {
+                auto &m = merged[key];
+                m.x += v.x;
+                m.y += v.y;
+                m.z += v.z;
+                m.intensity += v.intensity;
+                m.count += v.count;
+            }
+        }
+
+        out.resize(merged.size(), with_intensity);
+        size_t i = 0;
+        for (const auto &[key, v] : merged) {
+            double inv = 1.0 / v.count;
+            out.x[i] = static_cast<float>(v.x * inv);
+            out.y[i] = static_cast<float>(v.y * inv);
+            out.z[i] = static_cast<float>(v.z * inv);
+            if (with_intensity) {
+                out.intensity[i] = static_cast<float>(v.intensity * inv);
+            }
+            i++;
+        }
+    }
+
+   private:
+    static constexpr size_t MIN_POINTS_PER_THREAD = 32768;
+
+    // Run `task` on the slices, the first one on the calling thread and the others on the helpers
+    void run_slices(size_t nb_slices, const std::function<void(size_t)> &task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _task = &task;
+            _nb_slices = nb_slices;
+            _pending = nb_slices - 1;
+            _generation++;
+        }
+        _start.notify_all();
+        task(0);
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [this]() { return _pending == 0; });
+        _task = nullptr;
+    }
+
+    // The loop of the helper thread accumulating the slice `slice` of each cloud
+    void help(size_t slice)
+    {
+        uint64_t generation = 0;
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true) {
+            _start.wait(lock, [this, generation]() { return _stop || _generation != generation; });
+            if (_stop) {
+                return;
+            }
+            generation = _generation;
+            if (slice >= _nb_slices) {
+                // A small cloud doesn't need all the helpers
+                continue;
+            }
+            const auto *task = _task;
+            lock.unlock();
+            (*task)(slice);
+            lock.lock();
+            if (--_pending == 0) {
+                _done.notify_one();
+            }
+        }
+    }
+
+    struct Voxel {
+        double x = 0;
+        double y = 0;
+        double z = 0;
+        double intensity = 0;
+        uint32_t count = 0;
+    };
+
+    float _inv_leaf;
+    size_t _nb_threads;
+    // Kept across calls to reuse the buckets
+    std::vector<std::unordered_map<uint64_t, Voxel>> _partials;
+
+    std::vector<std::thread> _helpers;
+    std::mutex _mutex;
+    std::condition_variable _start;
+    std::condition_variable _done;
+    const std::function<void(size_t)> *_task = nullptr;
+    size_t _nb_slices = 0;
+    size_t _pending = 0;
+    uint64_t _generation = 0;
+    bool _stop = false;
+};
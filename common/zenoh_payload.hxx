@@ -0,0 +1,82 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "zenoh.hxx"
+
+#include "cdr_view.hxx"
+
+// Zenoh only exposes its shared memory buffers when built with the shared-memory and unstable features
+#if defined(Z_FEATURE_SHARED_MEMORY) && defined(Z_FEATURE_UNSTABLE_API)
+#define ZENOH_ROS_WITH_SHM
+#endif
+
+// A contiguous, read-only view over the payload of a Zenoh sample.
+// Zenoh exposes the payload as a list of slices. When it is made of a single
+// slice (the common case, even for multi-MB samples) we borrow it directly
+// instead of calling as_vector(). Only fragmented payloads are gathered once
+// into an owned buffer.
+// A payload received through shared memory is a single buffer mapped from the
+// segment of the publisher: it is decoded right where the publisher wrote it.
+// The view borrows from `bytes`, which must outlive it.
+class PayloadView {
+   public:
+    explicit PayloadView(const zenoh::Bytes &bytes)
+    {
+#ifdef ZENOH_ROS_WITH_SHM
+        if (auto shm = bytes.as_shm(); shm.has_value()) {
+            _span = ByteSpan{shm->get().data(), shm->get().len()};
+            _shared_memory = true;
+            return;
+        }
+#endif
+        auto it = bytes.slice_iter();
+        auto first = it.next();
+        if (!first.has_value()) {
+            return;
+        }
+        auto second = it.next();
+        if (!second.has_value()) {
+            _span = ByteSpan{first->data, first->len};
+            return;
+        }
+        _owned.reserve(bytes.size());
+        _owned.insert(_owned.end(), first->data, first->data + first->len);
+        _owned.insert(_owned.end(), second->data, second->data + second->len);
+        for (auto s = it.next(); s.has_value(); s = it.next()) {
+            _owned.insert(_owned.end(), s->data, s->data + s->len);
+        }
+        _span = ByteSpan{_owned.data(), _owned.size()};
+    }
+
+    PayloadView(const PayloadView &) = delete;
+    PayloadView &operator=(const PayloadView &) = delete;
+
+    const uint8_t *data() const { return _span.data; }
+    size_t size() const { return _span.size; }
+    ByteSpan span() const { return _span; }
+
+    // Whether the payload had to be copied because it was fragmented
+    bool copied() const { return !_owned.empty(); }
+
+    // Whether the payload is read from a shared memory segment
+    bool shared_memory() const { return _shared_memory; }
+
+   private:
+    ByteSpan _span;
+    std::vector<uint8_t> _owned;
+    bool _shared_memory = false;
+};
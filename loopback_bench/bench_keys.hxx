@@ -0,0 +1,83 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ros_types.hxx"
+
+// The topics published by synthetic_pub and measured by loopback_bench
+#define ROS_TOPIC_TF          "tf"
+#define ROS_TOPIC_POINT_CLOUD "point_cloud"
+
+// The ROS domain used in rmw_zenoh key expressions
+#define ROS_DOMAIN_ID "0"
+
+// The key names of a topic, either as routed by zenoh-bridge-ros2dds ("<topic>")
+// or as published by rmw_zenoh ("<domain_id>/<topic>/<type_name>/<type_hash>").
+enum class KeyFormat { Bridge, RmwZenoh };
+
+inline KeyFormat parse_key_format(std::string_view v)
+{
+    if (v == "bridge") {
+        return KeyFormat::Bridge;
+    } else if (v == "rmw_zenoh") {
+        return KeyFormat::RmwZenoh;
+    }
+    throw std::runtime_error(std::string("Unsupported key format: ") + std::string(v));
+}
+
+inline std::string topic_key(KeyFormat format, const char *topic, const char *type_name, const char *type_hash)
+{
+    if (format == KeyFormat::Bridge) {
+        return topic;
+    }
+    return std::string(ROS_DOMAIN_ID "/") + topic + "/" + type_name + "/" + type_hash;
+}
+
+// The key expression matching the publications of a topic, whatever their domain and type
+inline std::string topic_keyexpr(KeyFormat format, const char *topic)
+{
+    if (format == KeyFormat::Bridge) {
+        return topic;
+    }
+    return std::string("*/") + topic + "/*/*";
+}
+
+// At the end of the publication of a topic, its number of messages is published on
+// "<prefix><topic>", so that the messages lost before the first one received and after
+// the last one are counted as well
+#define BENCH_PUBLISHED_PREFIX "loopback_bench/published/"
+
+// The attachment carries the sequence number of each publication, to count drops
+inline std::vector<uint8_t> encode_sequence_number(uint64_t seq)
+{
+    std::vector<uint8_t> data(8);
+    for (size_t i = 0; i < 8; i++) {
+        data[i] = uint8_t(seq >> (8 * i));
+    }
+    return data;
+}
+
+inline uint64_t decode_sequence_number(const uint8_t *data, size_t len)
+{
+    uint64_t seq = 0;
+    for (size_t i = 0; i < 8 && i < len; i++) {
+        seq |= uint64_t(data[i]) << (8 * i);
+    }
+    return seq;
+}
@@ -0,0 +1,388 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+// Include Zenoh C++ API
+#include <zenoh.hxx>
+
+// Include args parser
+#include "getargs.hxx"
+
+// Include the CDR readers
+#include "cdr_view.hxx"
+#include "point_cloud_view.hxx"
+#include "zenoh_payload.hxx"
+
+// Include the decoding of the subscribers
+#include "pipeline.hxx"
+#include "point_cloud_fields.hxx"
+#include "tf_buffer.hxx"
+#include "tf_message_view.hxx"
+
+#include "latency_histogram.hxx"
+
+#include "bench_keys.hxx"
+
+using namespace std::chrono_literals;
+
+// Once the measurement is over, how long to wait for the publisher to send its number of messages
+#define PUBLISHED_COUNT_TIMEOUT 5s
+
+// The end-to-end statistics of a topic
+class TopicStats {
+   public:
+    explicit TopicStats(std::string name) : _name(std::move(name)) {}
+
+    void record(uint64_t latency_ns, size_t size, bool shared_memory)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _interval.record(latency_ns);
+        _total.record(latency_ns);
+        _interval_bytes += size;
+        _total_bytes += size;
+        if (shared_memory) {
+            _interval_shm++;
+            _total_shm++;
+        }
+    }
+
+    // Called in the order of reception, before the samples are queued to the workers
+    void record_sequence(std::optional<uint64_t> seq)
+    {
+        if (!seq) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        // A gap in the sequence numbers means that messages were lost on the way
+        if (_next_seq && *seq > *_next_seq) {
+            _interval_drops += *seq - *_next_seq;
+            _total_drops += *seq - *_next_seq;
+        }
+        _next_seq = *seq + 1;
+    }
+
+    // The number of messages the publisher sent, known once it's done
+    void set_published(uint64_t nb)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _published = nb;
+    }
+
+    void record_error()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _errors++;
+    }
+
+    // Messages were received, but the publisher didn't tell yet how many it sent
+    bool awaiting_published()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return !_published && (_next_seq || _total.count() + _errors > 0);
+    }
+
+    // Print the statistics since the last report, and start a new interval
+    void report(double period_s)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        print(_name.c_str(), _interval, _interval_bytes, _interval_shm, _interval_drops, period_s);
+        _interval.reset();
+        _interval_bytes = 0;
+        _interval_shm = 0;
+        _interval_drops = 0;
+    }
+
+    // `queue_dropped` is the number of messages received but dropped before the workers could decode them
+    void summary(double duration_s, uint64_t queue_dropped = 0)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        print((_name + " (total)").c_str(), _total, _total_bytes, _total_shm, _total_drops, duration_s);
+        if (_errors > 0) {
+            std::cout << "   " << _errors << " payloads could not be decoded" << std::endl;
+        }
+        if (queue_dropped > 0) {
+            std::cout << "   " << queue_dropped << " dropped by the queue of the workers" << std::endl;
+        }
+        // The gaps in the sequence numbers miss the losses before the first and after the last message received
+        if (_published) {
+            uint64_t received = _total.count() + _errors + queue_dropped;
+            std::cout << "   " << *_published << " published, " << received << " received, "
+                      << (*_published > received ? *_published - received : 0) << " lost" << std::endl;
+        } else {
+            std::cout << "   The number of published messages is unknown, only the gaps were counted" << std::endl;
+        }
+    }
+
+   private:
+    static void print(const char *name, const LatencyHistogram &h, uint64_t bytes, uint64_t shm, uint64_t drops,
+                      double period_s)
+    {
+        char line[256];
+        std::snprintf(line, sizeof(line),
+                      "[%s] %8.1f msg/s %9.2f MB/s | latency us p50 %8.1f p99 %8.1f p99.9 %8.1f max %8.1f | shm %3.0f%% "
+                      "| drops %llu",
+                      name, double(h.count()) / period_s, double(bytes) / period_s / 1e6, h.percentile(50) / 1e3,
+                      h.percentile(99) / 1e3, h.percentile(99.9) / 1e3, h.max() / 1e3,
+                      h.count() > 0 ? 100.0 * double(shm) / double(h.count()) : 0.0, (unsigned long long)drops);
+        std::cout << line << std::endl;
+    }
+
+    std::string _name;
+    std::mutex _mutex;
+    LatencyHistogram _interval;
+    LatencyHistogram _total;
+    uint64_t _interval_bytes = 0;
+    uint64_t _total_bytes = 0;
+    // The samples received through shared memory
+    uint64_t _interval_shm = 0;
+    uint64_t _total_shm = 0;
+    uint64_t _interval_drops = 0;
+    uint64_t _total_drops = 0;
+    uint64_t _errors = 0;
+    std::optional<uint64_t> _next_seq;
+    std::optional<uint64_t> _published;
+};
+
+// Cleared by CTRL-C, so that the summary is printed before exiting
+static std::atomic<bool> running{true};
+
+void stop_running(int) { running = false; }
+
+int64_t now_ns()
+{
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+int64_t stamp_ns(const TimeView &stamp) { return int64_t(stamp.sec) * 1000000000 + stamp.nanosec; }
+
+std::optional<uint64_t> sequence_number(const zenoh::Sample &sample)
+{
+    auto attachment = sample.get_attachment();
+    if (!attachment) {
+        return std::nullopt;
+    }
+    PayloadView view(attachment->get());
+    return decode_sequence_number(view.data(), view.size());
+}
+
+// The latency of a message, from its header stamp
+uint64_t latency_ns(int64_t received_ns, int64_t stamp_ns)
+{
+    return uint64_t(std::max<int64_t>(received_ns - stamp_ns, 0));
+}
+
+// Without `tf_buffer`, only the stamp of the first transform is read, as soon as the message is received.
+// Otherwise, the message is decoded into the transform cache like the subscribers do, and the latency
+// includes the decoding.
+void process_tf(const zenoh::Sample &sample, TopicStats &stats, TfBuffer *tf_buffer)
+{
+    int64_t received = now_ns();
+    PayloadView payload(sample.get_payload());
+    try {
+        int64_t stamp;
+        if (tf_buffer == nullptr) {
+            // The stamp of the first transform is enough: they're all stamped together
+            CdrReader reader(payload.span());
+            if (reader.read_u32() == 0) {
+                return;
+            }
+            TimeView t;
+            t.sec = reader.read_i32();
+            t.nanosec = reader.read_u32();
+            stamp = stamp_ns(t);
+        } else {
+            // Each worker reuses its own decoder, so that decoding doesn't allocate
+            thread_local TfMessageDecoder decoder(tf_buffer->frames());
+            const auto &transforms = decoder.decode(payload.span());
+            if (transforms.empty()) {
+                return;
+            }
+            set_transforms(*tf_buffer, transforms, false);
+            stamp = transforms.front().stamp_ns();
+            received = now_ns();
+        }
+        stats.record(latency_ns(received, stamp), payload.size(), payload.shared_memory());
+    } catch (const std::exception &) {
+        stats.record_error();
+    }
+}
+
+// Without `unpack`, only the header of the point cloud is parsed. Otherwise, its points are
+// unpacked like the subscribers do, and the latency includes the unpacking.
+void process_point_cloud(const zenoh::Sample &sample, TopicStats &stats, bool unpack)
+{
+    int64_t received = now_ns();
+    PayloadView payload(sample.get_payload());
+    try {
+        auto view = PointCloud2View::parse(payload.span());
+        if (unpack) {
+            // Each worker reuses its own buffers from one cloud to the next
+            thread_local PointLayoutCache layouts;
+            thread_local PointCloudSoA points;
+            const auto &layout = layouts.get(view);
+            if (!layout.has_value()) {
+                throw std::runtime_error("No usable x/y/z fields");
+            }
+            unpack_points(view, *layout, points);
+            received = now_ns();
+        }
+        stats.record(latency_ns(received, stamp_ns(view.header().stamp)), payload.size(), payload.shared_memory());
+    } catch (const std::exception &) {
+        stats.record_error();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // Initialize Zenoh logging
+    zenoh::init_log_from_env_or("error");
+
+    std::cout << "Zenoh ROS 2 Loopback Benchmark" << std::endl;
+
+    // Parse the arguments
+    auto &&[config, args] =
+        ConfigCliArgParser(argc, argv)
+            .named_value({"k", "key-format"}, "FORMAT", "Key names to subscribe to (bridge | rmw_zenoh)", "bridge")
+            .named_value({"p", "report-period"}, "SECONDS", "Period of the intermediate reports", "1")
+            .named_value({"d", "duration"}, "SECONDS", "Duration of the measurement (0 to run forever)", "0")
+            .named_flag({"decode"}, "Decode the messages on worker threads like the subscribers, "
+                                    "the latency includes the queueing and the decoding")
+            .named_value({"w", "workers"}, "WORKERS", "Number of worker threads decoding each topic, with --decode", "1")
+            .named_value({"queue-depth"}, "NUMBER",
+                         "Messages of each topic waiting for the workers before the oldest is dropped, with --decode",
+                         "100")
+            .run();
+    auto key_format = parse_key_format(args.value("k"));
+    double report_period = std::stod(std::string(args.value("p")));
+    double duration = std::stod(std::string(args.value("d")));
+    bool decode = args.flag("decode");
+    size_t nb_workers = std::stoul(std::string(args.value("w")));
+    size_t queue_depth = std::stoul(std::string(args.value("queue-depth")));
+
+    std::signal(SIGINT, stop_running);
+    std::signal(SIGTERM, stop_running);
+
+    // Initialize Zenoh session with the provided configuration
+    auto session = zenoh::Session::open(std::move(config));
+
+    TopicStats tf_stats(ROS_TOPIC_TF);
+    TopicStats point_cloud_stats(ROS_TOPIC_POINT_CLOUD);
+
+    // By default, the latency is measured in the subscriber callbacks: no queueing, only the transport is measured.
+    // With --decode, the callbacks hand the samples over to workers, as in rmw_zenoh_sub, which decode them.
+    TfBuffer tf_buffer;
+    std::optional<Pipeline<zenoh::Sample>> tf_pipeline;
+    std::optional<Pipeline<zenoh::Sample>> point_cloud_pipeline;
+    if (decode) {
+        tf_pipeline.emplace(ROS_TOPIC_TF, queue_depth, OverflowPolicy::DropOldest, nb_workers,
+                            [&tf_stats, &tf_buffer](zenoh::Sample &sample) { process_tf(sample, tf_stats, &tf_buffer); });
+        point_cloud_pipeline.emplace(ROS_TOPIC_POINT_CLOUD, queue_depth, OverflowPolicy::DropOldest, nb_workers,
+                                     [&point_cloud_stats](zenoh::Sample &sample) {
+                                         process_point_cloud(sample, point_cloud_stats, true);
+                                     });
+        std::cout << "Decoding with " << nb_workers << " workers per topic" << std::endl;
+    }
+
+    zenoh::KeyExpr tf_keyexpr(topic_keyexpr(key_format, ROS_TOPIC_TF));
+    std::optional<zenoh::Subscriber<void>> tf_subscriber(session.declare_subscriber(
+        tf_keyexpr,
+        [&tf_stats, &tf_pipeline](const zenoh::Sample &sample) {
+            tf_stats.record_sequence(sequence_number(sample));
+            if (tf_pipeline) {
+                // Cloning a sample only takes a reference on its payload
+                tf_pipeline->push(sample.clone());
+            } else {
+                process_tf(sample, tf_stats, nullptr);
+            }
+        },
+        zenoh::closures::none));
+    std::cout << "Subscribing to " << tf_keyexpr.as_string_view() << std::endl;
+
+    zenoh::KeyExpr point_cloud_keyexpr(topic_keyexpr(key_format, ROS_TOPIC_POINT_CLOUD));
+    std::optional<zenoh::Subscriber<void>> point_cloud_subscriber(session.declare_subscriber(
+        point_cloud_keyexpr,
+        [&point_cloud_stats, &point_cloud_pipeline](const zenoh::Sample &sample) {
+            point_cloud_stats.record_sequence(sequence_number(sample));
+            if (point_cloud_pipeline) {
+                point_cloud_pipeline->push(sample.clone());
+            } else {
+                process_point_cloud(sample, point_cloud_stats, false);
+            }
+        },
+        zenoh::closures::none));
+    std::cout << "Subscribing to " << point_cloud_keyexpr.as_string_view() << std::endl;
+
+    // The number of messages of each topic, sent by the publisher once it's done
+    auto published_subscriber = session.declare_subscriber(
+        zenoh::KeyExpr(BENCH_PUBLISHED_PREFIX "*"),
+        [&tf_stats, &point_cloud_stats](const zenoh::Sample &sample) {
+            auto key = sample.get_keyexpr().as_string_view();
+            auto topic = key.substr(key.rfind('/') + 1);
+            PayloadView payload(sample.get_payload());
+            uint64_t nb = decode_sequence_number(payload.data(), payload.size());
+            if (topic == ROS_TOPIC_TF) {
+                tf_stats.set_published(nb);
+            } else if (topic == ROS_TOPIC_POINT_CLOUD) {
+                point_cloud_stats.set_published(nb);
+            }
+        },
+        zenoh::closures::none);
+
+    auto start = std::chrono::steady_clock::now();
+    auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(report_period));
+    auto next = start + period;
+    while (running &&
+           (duration <= 0 || std::chrono::steady_clock::now() - start < std::chrono::duration<double>(duration))) {
+        // Wake up regularly to stop soon after CTRL-C
+        while (running && std::chrono::steady_clock::now() < next) {
+            std::this_thread::sleep_until(std::min(next, std::chrono::steady_clock::now() + 100ms));
+        }
+        if (!running) {
+            break;
+        }
+        next += period;
+        point_cloud_stats.report(report_period);
+        tf_stats.report(report_period);
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // The publisher may still be sending when the duration is over: its counts come after its last messages
+    auto deadline = std::chrono::steady_clock::now() + PUBLISHED_COUNT_TIMEOUT;
+    while (running && (tf_stats.awaiting_published() || point_cloud_stats.awaiting_published()) &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(100ms);
+    }
+
+    // Stop receiving, then let the workers decode what's already queued
+    tf_subscriber.reset();
+    point_cloud_subscriber.reset();
+    uint64_t tf_queue_dropped = tf_pipeline ? tf_pipeline->dropped() : 0;
+    uint64_t point_cloud_queue_dropped = point_cloud_pipeline ? point_cloud_pipeline->dropped() : 0;
+    tf_pipeline.reset();
+    point_cloud_pipeline.reset();
+
+    point_cloud_stats.summary(elapsed, point_cloud_queue_dropped);
+    tf_stats.summary(elapsed, tf_queue_dropped);
+    return 0;
+}
@@ -0,0 +1,182 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <variant>
+#include <vector>
+
+// Include Zenoh C++ API
+#include <zenoh.hxx>
+
+// Include args parser
+#include "getargs.hxx"
+
+// Include the synthetic messages
+#include "synthetic_messages.hxx"
+#include "zenoh_payload.hxx"
+
+#include "bench_keys.hxx"
+
+using namespace std::chrono_literals;
+
+// The number of payloads of a topic that can be in flight in its shared memory pool
+#define SHM_PAYLOADS_IN_FLIGHT 8
+
+// Where the published payloads are written: a copy handed over to the Zenoh transport,
+// or a buffer of a shared memory pool that the subscribers on the same host map directly
+class PayloadWriter {
+   public:
+    // A pool size of 0 disables shared memory
+    explicit PayloadWriter(size_t shm_pool_size)
+    {
+        if (shm_pool_size == 0) {
+            return;
+        }
+#ifdef ZENOH_ROS_WITH_SHM
+        _provider = std::make_unique<zenoh::PosixShmProvider>(
+            zenoh::MemoryLayout(shm_pool_size, zenoh::AllocAlignment({0})));
+#else
+        throw std::runtime_error("Shared memory requires zenoh-c built with the shared-memory and unstable features");
+#endif
+    }
+
+    zenoh::Bytes write(const std::vector<uint8_t> &bytes) const
+    {
+#ifdef ZENOH_ROS_WITH_SHM
+        if (_provider) {
+            // Wait for the subscribers to release a buffer when the pool is exhausted
+            auto result = _provider->alloc_gc_defrag_blocking(bytes.size(), zenoh::AllocAlignment({0}));
+            if (!std::holds_alternative<zenoh::ZShmMut>(result)) {
+                throw std::runtime_error("Failed to allocate " + std::to_string(bytes.size()) +
+                                         " bytes of shared memory");
+            }
+            auto buffer = std::get<zenoh::ZShmMut>(std::move(result));
+            std::memcpy(buffer.data(), bytes.data(), bytes.size());
+            return zenoh::Bytes(std::move(buffer));
+        }
+#endif
+        return zenoh::Bytes(bytes);
+    }
+
+   private:
+#ifdef ZENOH_ROS_WITH_SHM
+    std::unique_ptr<zenoh::PosixShmProvider> _provider;
+#endif
+};
+
+// Publish a synthetic payload `burst` times per period, re-stamping it before each publication
+void publish_loop(const zenoh::Session &session, const zenoh::Publisher &publisher, SyntheticPayload payload,
+                  bool shm, double rate_hz, size_t burst,
+                  std::chrono::steady_clock::time_point end, const char *name)
+{
+    // A real publisher would serialize straight into the shared memory buffer, the copy stands for it
+    PayloadWriter writer(shm ? payload.size() * SHM_PAYLOADS_IN_FLIGHT : 0);
+    auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / rate_hz));
+    auto next = std::chrono::steady_clock::now();
+    uint64_t seq = 0;
+    while (std::chrono::steady_clock::now() < end) {
+        for (size_t i = 0; i < burst; i++) {
+            auto now = std::chrono::system_clock::now().time_since_epoch();
+            payload.stamp(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+
+            auto options = zenoh::Publisher::PutOptions::create_default();
+            options.attachment = zenoh::Bytes(encode_sequence_number(seq));
+            publisher.put(writer.write(payload.bytes()), std::move(options));
+            seq++;
+        }
+        // Keep a steady rate: don't accumulate the time spent publishing
+        next += period;
+        std::this_thread::sleep_until(next);
+    }
+    // Tell the benchmark how many messages it should have received
+    session.put(zenoh::KeyExpr(std::string(BENCH_PUBLISHED_PREFIX) + name), zenoh::Bytes(encode_sequence_number(seq)));
+    std::cout << "[" << name << "] Published " << seq << " messages of " << payload.size() << " bytes" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    // Initialize Zenoh logging
+    zenoh::init_log_from_env_or("error");
+
+    std::cout << "Zenoh Synthetic ROS 2 Publisher" << std::endl;
+
+    // Parse the arguments
+    auto &&[config, args] =
+        ConfigCliArgParser(argc, argv)
+            .named_value({"k", "key-format"}, "FORMAT", "Key names to publish on (bridge | rmw_zenoh)", "bridge")
+            .named_value({"point-cloud-size"}, "BYTES", "Size of the point cloud data (0 to disable)", "2000000")
+            .named_value({"point-cloud-rate"}, "HZ", "Publication rate of the point clouds", "10")
+            .named_value({"tf-transforms"}, "NUMBER", "Number of transforms per TFMessage (0 to disable)", "10")
+            .named_value({"tf-rate"}, "HZ", "Publication rate of the TF messages", "100")
+            .named_value({"burst"}, "NUMBER", "Number of messages published back to back at each period", "1")
+            .named_value({"d", "duration"}, "SECONDS", "Duration of the publication", "10")
+            .named_flag({"big-endian"}, "Serialize the messages in big endian")
+            .run();
+    auto key_format = parse_key_format(args.value("k"));
+    size_t point_cloud_size = std::stoul(std::string(args.value("point-cloud-size")));
+    double point_cloud_rate = std::stod(std::string(args.value("point-cloud-rate")));
+    size_t tf_transforms = std::stoul(std::string(args.value("tf-transforms")));
+    double tf_rate = std::stod(std::string(args.value("tf-rate")));
+    size_t burst = std::stoul(std::string(args.value("burst")));
+    double duration = std::stod(std::string(args.value("d")));
+    bool little_endian = !args.flag("big-endian");
+    // The --shm flag only exists with zenoh-c
+#ifdef ZENOHCXX_ZENOHC
+    bool shm = args.flag("shm");
+#else
+    bool shm = false;
+#endif
+
+    if ((point_cloud_size > 0 && point_cloud_rate <= 0) || (tf_transforms > 0 && tf_rate <= 0)) {
+        throw std::runtime_error("The publication rates must be greater than 0");
+    }
+
+    // Initialize Zenoh session with the provided configuration
+    auto session = zenoh::Session::open(std::move(config));
+
+    // Let the subscribers discover us before we start measuring
+    std::this_thread::sleep_for(1s);
+    auto end = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                      std::chrono::duration<double>(duration));
+
+    std::vector<std::thread> threads;
+    std::vector<zenoh::Publisher> publishers;
+    publishers.reserve(2);
+    if (point_cloud_size > 0) {
+        auto key = topic_key(key_format, ROS_TOPIC_POINT_CLOUD, POINT_CLOUD2_TYPE_NAME, POINT_CLOUD2_TYPE_HASH);
+        std::cout << "Publishing " << point_cloud_size << " bytes point clouds at " << point_cloud_rate
+                  << " Hz on '" << key << "'" << std::endl;
+        publishers.push_back(session.declare_publisher(zenoh::KeyExpr(key)));
+        threads.emplace_back(publish_loop, std::cref(session), std::cref(publishers.back()),
+                             make_point_cloud(point_cloud_size, little_endian),
+                             shm, point_cloud_rate, burst, end, ROS_TOPIC_POINT_CLOUD);
+    }
+    if (tf_transforms > 0) {
+        auto key = topic_key(key_format, ROS_TOPIC_TF, TF_MESSAGE_TYPE_NAME, TF_MESSAGE_TYPE_HASH);
+        std::cout << "Publishing " << tf_transforms << " transforms at " << tf_rate << " Hz on '" << key << "'"
+                  << std::endl;
+        publishers.push_back(session.declare_publisher(zenoh::KeyExpr(key)));
+        threads.emplace_back(publish_loop, std::cref(session), std::cref(publishers.back()),
+                             make_tf_message(tf_transforms, little_endian),
+                             shm, tf_rate, burst, end, ROS_TOPIC_TF);
+    }
+
+    for (auto &t : threads) {
+        t.join();
+    }
+    return 0;
+}
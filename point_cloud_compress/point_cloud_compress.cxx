@@ -0,0 +1,180 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// Include Zenoh C++ API
+#include <zenoh.hxx>
+
+// Include args parser
+#include "getargs.hxx"
+
+// Include the CDR helpers
+#include "point_cloud_view.hxx"
+#include "zenoh_payload.hxx"
+
+// Include the point cloud compression
+#include "point_cloud_codec.hxx"
+
+// Include the processing pipeline
+#include "pipeline.hxx"
+
+// Include the instrumentation
+#include "topic_metrics.hxx"
+
+using namespace std::chrono_literals;
+
+// The point clouds waiting to be compressed: only the latest ones are worth sending
+#define INPUT_QUEUE_DEPTH 5
+
+// Cleared by CTRL-C
+static std::atomic<bool> running{true};
+
+void stop_running(int) { running = false; }
+
+int main(int argc, char **argv)
+{
+    // Initialize Zenoh logging
+    zenoh::init_log_from_env_or("error");
+
+    std::cout << "Zenoh Point Cloud Compressor" << std::endl;
+
+    // Parse the arguments
+    auto &&[config, args] =
+        ConfigCliArgParser(argc, argv)
+            .named_value({"i", "input"}, "KEY",
+                         "Key expression of the PointCloud2 messages (e.g. '*/point_cloud/*/*' with rmw_zenoh)",
+                         "point_cloud")
+            .named_value({"o", "output"}, "KEY", "Key to publish the compressed point clouds on",
+                         "point_cloud/compressed")
+            .named_value({"voxel-size"}, "METERS", "Keep a single point per voxel of this size (0 to disable)", "0")
+            .named_value({"stride"}, "NUMBER", "Keep one point out of NUMBER", "1")
+            .named_value({"chunk-points"}, "NUMBER", "Number of points unpacked and encoded at once",
+                         std::to_string(POINT_CLOUD_CODEC_CHUNK_POINTS))
+            .named_flag({"drop-intensity"}, "Don't send the intensity of the points")
+            .named_value({"w", "workers"}, "WORKERS", "Number of worker threads compressing the point clouds", "1")
+            .named_value({"stats-period"}, "SECONDS", "Period of the statistics log line (0 to disable)", "5")
+            .run();
+    std::string input_key(args.value("i"));
+    std::string output_key(args.value("o"));
+    PointCloudCodecOptions options;
+    options.voxel_size = std::stof(std::string(args.value("voxel-size")));
+    options.stride = std::stoul(std::string(args.value("stride")));
+    options.chunk_points = std::stoul(std::string(args.value("chunk-points")));
+    options.drop_intensity = args.flag("drop-intensity");
+    size_t nb_workers = std::stoul(std::string(args.value("w")));
+    double stats_period = std::stod(std::string(args.value("stats-period")));
+
+    std::signal(SIGINT, stop_running);
+    std::signal(SIGTERM, stop_running);
+
+    // Initialize Zenoh session with the provided configuration
+    auto session = zenoh::Session::open(std::move(config));
+    auto publisher = session.declare_publisher(zenoh::KeyExpr(output_key));
+
+    // The statistics of the received point clouds, the encoding time is recorded as the decoding time
+    MetricsRegistry metrics;
+    auto &input_metrics = metrics.add("point_cloud");
+    std::atomic<uint64_t> bytes_in{0};
+    std::atomic<uint64_t> bytes_out{0};
+
+    // Compress each point cloud and publish it
+    auto handler = [&publisher, &options, &input_metrics, &bytes_in, &bytes_out](const Timed<zenoh::Sample> &timed) {
+        const zenoh::Sample &sample = timed.value;
+        int64_t queue_ns = system_time_ns() - timed.received_ns;
+        auto start = std::chrono::steady_clock::now();
+
+        // Decode the CDR payload in place: the point data is not copied
+        PayloadView payload(sample.get_payload());
+        PointCloud2View point_cloud;
+        try {
+            point_cloud = PointCloud2View::parse(payload.span());
+        } catch (const std::exception &e) {
+            std::cerr << "Failed to decode PointCloud2: " << e.what() << std::endl;
+            input_metrics.record_error(payload.size());
+            return;
+        }
+
+        // Each worker reuses its own encoder and output buffer from one cloud to the next
+        thread_local PointCloudEncoder encoder(options);
+        thread_local std::vector<uint8_t> frame;
+        if (!encoder.encode(point_cloud, frame)) {
+            std::cerr << "No usable x/y/z fields in the point cloud of " << sample.get_keyexpr().as_string_view()
+                      << std::endl;
+            input_metrics.record_error(payload.size());
+            return;
+        }
+        int64_t encode_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now() - start).count();
+        const auto &stamp = point_cloud.header().stamp;
+        std::optional<int64_t> latency_ns;
+        if (stamp.sec != 0 || stamp.nanosec != 0) {
+            latency_ns = timed.received_ns - stamp_ns(stamp.sec, stamp.nanosec);
+        }
+        input_metrics.record(payload.size(), queue_ns, encode_ns, latency_ns);
+        bytes_in.fetch_add(payload.size(), std::memory_order_relaxed);
+        bytes_out.fetch_add(frame.size(), std::memory_order_relaxed);
+
+        // The frame is small: copying it is cheaper than giving the buffer away
+        publisher.put(zenoh::Bytes(frame));
+
+        std::ostringstream out;
+        out << ">> [Point Cloud Compressor] Time=" << stamp << ", Points=" << point_cloud.point_count() << " -> "
+            << encoder.nb_points() << ", Size=" << payload.size() << " -> " << frame.size() << " ("
+            << std::fixed << std::setprecision(1) << double(payload.size()) / double(frame.size())
+            << "x), Encoding=" << std::setprecision(2) << double(encode_ns) / 1e6 << " ms\n";
+        std::cout << out.str();
+    };
+
+    // The point clouds are compressed by the workers, the Zenoh callback only hands them over
+    Pipeline<Timed<zenoh::Sample>> pipeline("point_cloud", INPUT_QUEUE_DEPTH, OverflowPolicy::DropOldest, nb_workers,
+                                            handler);
+    input_metrics.track_queue(pipeline);
+    auto subscriber = session.declare_subscriber(
+                        zenoh::KeyExpr(input_key),
+                        [&pipeline](const zenoh::Sample &sample) { pipeline.push({sample.clone(), system_time_ns()}); },
+                        zenoh::closures::none
+                      );
+    std::cout << "Compressing the point clouds of '" << input_key << "' to '" << output_key << "'" << std::endl;
+
+    // Waiting for CTRL-C to exit
+    std::cout << "Press CTRL-C to quit...\n";
+    auto stats_interval = stats_period > 0 ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                 std::chrono::duration<double>(stats_period))
+                                           : std::chrono::steady_clock::duration(1s);
+    auto next_stats = std::chrono::steady_clock::now() + stats_interval;
+    while (running) {
+        std::this_thread::sleep_for(1s);
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next_stats) {
+            auto report = metrics.report();
+            if (stats_period > 0) {
+                uint64_t in = bytes_in.load(std::memory_order_relaxed);
+                uint64_t out = bytes_out.load(std::memory_order_relaxed);
+                std::ostringstream ratio;
+                ratio << std::fixed << std::setprecision(1) << (out > 0 ? double(in) / double(out) : 0.0);
+                std::cout << report;
+                std::cout << ">> [Stats] compression: " << in << " bytes -> " << out << " bytes (" << ratio.str()
+                          << "x)\n";
+            }
+            next_stats = now + stats_interval;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+//
+// Copyright (c) 2025 ZettaScale Technology
+//
+// This program and the accompanying materials are made available under the
+// terms of the Apache License, Version 2.0
+// which is available at https://www.apache.org/licenses/LICENSE-2.0.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Contributors:
+//   ChenYing Kuo, <cy@zettascale.tech>
+//
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+// Include Zenoh C++ API
+#include <zenoh.hxx>
+
+// Include args parser
+#include "getargs.hxx"
+
+// Include the payload helpers
+#include "zenoh_payload.hxx"
+
+// Include the point cloud compression
+#include "point_cloud_codec.hxx"
+
+using namespace std::chrono_literals;
+
+// Cleared by CTRL-C
+static std::atomic<bool> running{true};
+
+void stop_running(int) { running = false; }
+
+int main(int argc, char **argv)
+{
+    // Initialize Zenoh logging
+    zenoh::init_log_from_env_or("error");
+
+    std::cout << "Zenoh Compressed Point Cloud Subscriber" << std::endl;
+
+    // Parse the arguments
+    auto &&[config, args] = ConfigCliArgParser(argc, argv)
+                                .named_value({"k", "key"}, "KEY", "Key expression of the compressed point clouds",
+                                             "point_cloud/compressed")
+                                .run();
+    std::string key(args.value("k"));
+
+    std::signal(SIGINT, stop_running);
+    std::signal(SIGTERM, stop_running);
+
+    // Initialize Zenoh session with the provided configuration
+    auto session = zenoh::Session::open(std::move(config));
+
+    // The frames are small and quick to decode: they're decoded in the Zenoh callback
+    auto subscriber = session.declare_subscriber(
+        zenoh::KeyExpr(key),
+        [](const zenoh::Sample &sample) {
+            std::ostringstream out;
+            out << ">> [Compressed Point Cloud Subscriber] Zenoh key: " << sample.get_keyexpr().as_string_view()
+                << ", Size: " << sample.get_payload().size() << "\n";
+
+            // The chunks are decoded one by one into the same buffers
+            thread_local PointCloudSoA chunk;
+            PayloadView payload(sample.get_payload());
+            try {
+                PointCloudDecoder decoder(payload.span());
+                const auto &header = decoder.header();
+                out << "   Time=" << header.stamp << ", Frame ID=" << header.frame_id
+                    << ", Points=" << header.nb_points << ", Chunks=" << header.nb_chunks
+                    << ", Intensity=" << (header.has_intensity ? "yes" : "no") << "\n";
+                float min_z = INFINITY, max_z = -INFINITY;
+                while (decoder.next_chunk(chunk)) {
+                    for (size_t i = 0; i < chunk.size(); i++) {
+                        min_z = std::min(min_z, chunk.z[i]);
+                        max_z = std::max(max_z, chunk.z[i]);
+                    }
+                }
+                if (header.nb_points > 0) {
+                    out << "   Z range: [" << min_z << ", " << max_z << "]\n";
+                }
+            } catch (const std::exception &e) {
+                std::cerr << "   Failed to decode the compressed point cloud: " << e.what() << std::endl;
+                return;
+            }
+            std::cout << out.str();
+        },
+        zenoh::closures::none);
+
+    // Waiting for CTRL-C to exit
+    std::cout << "Press CTRL-C to quit...\n";
+    while (running) {
+        std::this_thread::sleep_for(1s);
+    }
+    return 0;
+}
@@ -10,9 +10,14 @@
 // Contributors:
 //   ChenYing Kuo, <cy@zettascale.tech>
 //
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <csignal>
 #include <iostream>
+#include <sstream>
 #include <thread>
+#include <vector>
 
 // Include Zenoh C++ API
 #include <zenoh.hxx>
@@ -20,7 +25,34 @@
 // Include args parser
 #include "getargs.hxx"
 
+// Include the CDR helpers
+#include "idl_cdr.hxx"
+#include "point_cloud_view.hxx"
+#include "zenoh_payload.hxx"
+
+// Include the point cloud processing
+#include "point_cloud_fields.hxx"
+#include "voxel_grid.hxx"
+
+// Include the transform cache
+#include "tf_buffer.hxx"
+#include "tf_message_view.hxx"
+#include "tf_static_snapshot.hxx"
+
+// Include the processing pipeline
+#include "pipeline.hxx"
+
+// Include the instrumentation
+#include "topic_metrics.hxx"
+
+// Include the recorder
+#include "mcap_recorder.hxx"
+
+// Include the discovery of the ROS 2 graph
+#include "ros_discovery.hxx"
+
 // Include the message types you need
+#include "ros_types.hxx"
 #include "PointCloud2.hpp"
 #include "TFMessage.hpp"
 
@@ -41,12 +73,28 @@ using namespace std::chrono_literals;
 //#define MANGLED_POINT_CLOUD   "%local_costmap%clearing_endpoints"
 //#define ROS_TOPIC_POINT_CLOUD "*/local_costmap/clearing_endpoints/*/*"
 
+// The ROS domain of the liveliness tokens and of the discovered topics
+#define ROS_DOMAIN_ID "0"
+
 // The name that will be shown in ROS 2 node list
 #define NODE_NAME "zenoh_sub"
 
 // The history depth for the subscriber
 #define HISTORY_DEPTH 100
 
+// The maximum queue depth of each discovered topic, within the history of its QoS
+#define DISCOVERY_TF_QUEUE_DEPTH          1000
+#define DISCOVERY_POINT_CLOUD_QUEUE_DEPTH 20
+// The samples requested from each transient local publisher: a single point cloud is worth having
+#define DISCOVERY_TF_HISTORY_DEPTH          100
+#define DISCOVERY_POINT_CLOUD_HISTORY_DEPTH 1
+
+// The QoS of each topic, as encoded in the liveliness tokens
+#define QOS_TF          "::,100:,:,:,,"    // Volatile, Keep last 100
+#define QOS_TF_STATIC   ":1:,1:,:,:,,"     // Transient Local, Keep last 1
+#define QOS_POINT_CLOUD "::,5:,:,:,,"      // Volatile, Keep last 5
+//#define QOS_POINT_CLOUD ":1:,1:,:,:,,"   // Transient Local, Keep last 1
+
 // The function is to get the next unique ID for entities used in ROS 2.
 int get_next_entities_id()
 {
@@ -54,6 +102,11 @@ int get_next_entities_id()
     return id++;
 }
 
+// Cleared by CTRL-C, so that the recording is completed before exiting
+static std::atomic<bool> running{true};
+
+void stop_running(int) { running = false; }
+
 int main(int argc, char **argv)
 {
     // Initialize Zenoh logging
@@ -62,97 +115,318 @@ int main(int argc, char **argv)
     std::cout << "Zenoh RMW Subscriber Example" << std::endl;
 
     // Parse the arguments
-    auto &&[config, args] = ConfigCliArgParser(argc, argv).run();
+    auto &&[config, args] = ConfigCliArgParser(argc, argv)
+                                .named_value({"w", "workers"}, "WORKERS", "Number of worker threads processing each topic", "1")
+                                .named_value({"voxel-size"}, "METERS",
+                                             "Downsample the point clouds with a voxel grid of this size (0 to disable)", "0")
+                                .named_values({"tf-lookup"}, "TARGET:SOURCE",
+                                              "Print the latest transform from SOURCE to TARGET frame every second")
+                                .named_value({"stats-period"}, "SECONDS",
+                                             "Period of the statistics log line (0 to disable)", "5")
+                                .named_value({"record"}, "FILE", "Record the raw samples into an MCAP file", "")
+                                .named_value({"record-compression"}, "COMPRESSION",
+                                             "Compression of the recorded chunks (none | zstd)", "none")
+                                .named_value({"record-chunk-size"}, "BYTES", "Size of the recorded chunks",
+                                             std::to_string(MCAP_DEFAULT_CHUNK_SIZE))
+                                .named_value({"record-queue-size"}, "BYTES",
+                                             "Payload bytes waiting to be written before new samples are dropped",
+                                             std::to_string(RECORDER_QUEUE_BYTES))
+                                .named_value({"tf-static-snapshot"}, "FILE",
+                                             "Load the static transforms from FILE at startup, and keep it up to date", "")
+                                .named_flag({"discovery"},
+                                            "Subscribe to all the TF and point cloud topics found in the ROS 2 graph")
+                                .run();
+    size_t nb_workers = std::stoul(std::string(args.value("w")));
+    float voxel_size = std::stof(std::string(args.value("voxel-size")));
+    double stats_period = std::stod(std::string(args.value("stats-period")));
+    std::string record_path(args.value("record"));
+    McapOptions record_options;
+    record_options.compression = parse_mcap_compression(args.value("record-compression"));
+    record_options.chunk_size = std::stoul(std::string(args.value("record-chunk-size")));
+    size_t record_queue_bytes = std::stoul(std::string(args.value("record-queue-size")));
+    std::string snapshot_path(args.value("tf-static-snapshot"));
+    bool discovery_mode = args.flag("discovery");
+
+    std::signal(SIGINT, stop_running);
+    std::signal(SIGTERM, stop_running);
+
+    // The transforms received on /tf and /tf_static are kept in an in-process cache
+    TfBuffer tf_buffer;
+
+    // Start with the static transforms known at the previous run, without waiting for the /tf_static history.
+    // They are replaced as the publishers send them again.
+    std::unique_ptr<TfStaticSnapshot> tf_static_snapshot;
+    if (!snapshot_path.empty()) {
+        tf_static_snapshot = std::make_unique<TfStaticSnapshot>(snapshot_path);
+        try {
+            size_t nb_loaded = tf_static_snapshot->load(tf_buffer);
+            std::cout << "Loaded " << nb_loaded << " static transforms from " << snapshot_path << std::endl;
+        } catch (const std::exception &e) {
+            // The snapshot is only a head start, it's rewritten from the live history
+            std::cerr << "Ignoring the tf_static snapshot: " << e.what() << std::endl;
+        }
+    }
 
     // Initialize Zenoh session with the provided configuration
     auto session = zenoh::Session::open(std::move(config));
 
-    // Subscribe to /tf
-    zenoh::KeyExpr tf_keyexpr(ROS_TOPIC_TF);
-    auto tf_handler = [](const zenoh::Sample & sample) {
-        std::cout << ">> [TF Subscriber] Zenoh key: " << sample.get_keyexpr().as_string_view()
-                  << ", Size: " << sample.get_payload().size() << std::endl;
-
-        // Deserialize the CDR payload
-        tf2_msgs::msg::TFMessage tf_msg;
-        basic_cdr_stream stream;
-        // Get the payload and set the buffer for the stream
-        auto buffer = sample.get_payload().as_vector();
-        stream.set_buffer(buffer.data() + 4, buffer.size());
-        // Read the TFMessage from the stream
-        read(stream, tf_msg, key_mode::not_key);
+    // Each topic is processed by its own pipeline, samples are timestamped when received
+    using SamplePipeline = Pipeline<Timed<zenoh::Sample>>;
+
+    // The statistics of each subscription
+    MetricsRegistry metrics;
+
+    // Record the samples as they are received, before they are processed
+    std::unique_ptr<McapRecorder> recorder;
+    if (!record_path.empty()) {
+        recorder = std::make_unique<McapRecorder>(record_path, record_options, RECORDER_QUEUE_DEPTH,
+                                                  record_queue_bytes);
+        std::cout << "Recording to " << record_path << std::endl;
+    }
+
+    // Decode the TFMessages of /tf and /tf_static
+    auto tf_handler = [&tf_buffer, &tf_static_snapshot](const Timed<zenoh::Sample> &timed, TopicMetrics &metrics, bool is_static) {
+        const zenoh::Sample &sample = timed.value;
+        int64_t queue_ns = system_time_ns() - timed.received_ns;
+        auto start = std::chrono::steady_clock::now();
+
+        // Write the whole report at once, so that the outputs of the workers don't interleave
+        std::ostringstream out;
+        out << ">> [TF Subscriber] Zenoh key: " << sample.get_keyexpr().as_string_view()
+            << ", Size: " << sample.get_payload().size() << "\n";
+
+        // Decode the CDR payload in place, frame names are interned in the transform cache.
+        // Each worker reuses its own decoder, so that decoding doesn't allocate.
+        thread_local TfMessageDecoder decoder(tf_buffer.frames());
+        // Borrow the payload without copying it, unless it's fragmented
+        PayloadView payload(sample.get_payload());
+        try {
+            decoder.decode(payload.span());
+        } catch (const std::exception &e) {
+            std::cerr << "   Failed to deserialize TFMessage: " << e.what() << std::endl;
+            metrics.record_error(payload.size());
+            return;
+        }
+        int64_t decode_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now() - start).count();
+
+        // The transforms of a message are stamped together: the first one tells how old they are.
+        // Static transforms are stamped once and replayed to late joiners, their age is meaningless.
+        std::optional<int64_t> latency_ns;
+        const auto &transforms = decoder.transforms();
+        if (!is_static && !transforms.empty()) {
+            const auto &stamp = transforms.front().header.stamp;
+            if (stamp.sec != 0 || stamp.nanosec != 0) {
+                latency_ns = timed.received_ns - stamp_ns(stamp.sec, stamp.nanosec);
+            }
+        }
+        metrics.record(payload.size(), queue_ns, decode_ns, latency_ns);
+
+        // Update the transform cache
+        set_transforms(tf_buffer, transforms, is_static);
+        if (is_static && tf_static_snapshot) {
+            tf_static_snapshot->update(transforms);
+        }
 
         // Print some information about the TFMessage
-        std::cout << "   Number of transforms: " << tf_msg.transforms().size() << std::endl;
-        for (const auto &transform : tf_msg.transforms()) {
-            std::cout << "   Transform: " << transform.header().stamp()
-                      << ", Frame ID: " << transform.header().frame_id()
-                      << ", Child Frame ID: " << transform.child_frame_id() << std::endl;
-            std::cout << "   Translation: (" 
-                      << transform.transform().translation().x() << ", "
-                      << transform.transform().translation().y() << ", "
-                      << transform.transform().translation().z() << ")" << std::endl;
-            std::cout << "   Rotation: (" 
-                      << transform.transform().rotation().x() << ", "
-                      << transform.transform().rotation().y() << ", "
-                      << transform.transform().rotation().z() << ", "
-                      << transform.transform().rotation().w() << ")" << std::endl;
+        out << "   Number of transforms: " << transforms.size() << "\n";
+        for (const auto &transform : transforms) {
+            out << "   Transform: " << transform.header.stamp
+                << ", Frame ID: " << transform.header.frame_id
+                << ", Child Frame ID: " << transform.child_frame_id << "\n";
+            out << "   Translation: ("
+                << transform.transform.translation.x << ", "
+                << transform.transform.translation.y << ", "
+                << transform.transform.translation.z << ")\n";
+            out << "   Rotation: ("
+                << transform.transform.rotation.x << ", "
+                << transform.transform.rotation.y << ", "
+                << transform.transform.rotation.z << ", "
+                << transform.transform.rotation.w << ")\n";
         }
+        std::cout << out.str();
     }; 
-    auto tf_subscriber = session.declare_subscriber(
-                                    tf_keyexpr,               // TF key expression
-                                    std::move(tf_handler),    // The callback to receive sample
-                                    zenoh::closures::none     // Drop callback which is not used
-                                 );
-
-    // Subscribe to /point_cloud
-    zenoh::KeyExpr point_cloud_keyexpr(ROS_TOPIC_POINT_CLOUD);
-    auto point_cloud_handler = [](const zenoh::Sample & sample) {
-        std::cout << ">> [Point Cloud Subscriber] Zenoh key: " << sample.get_keyexpr().as_string_view()
-                  << ", Size: " << sample.get_payload().size() << std::endl;
-
-        // Deserialize the CDR payload
-        sensor_msgs::msg::PointCloud2 point_cloud_msg;
-        basic_cdr_stream stream;
-        // Get the payload and set the buffer for the stream
-        auto buffer = sample.get_payload().as_vector();
-        stream.set_buffer(buffer.data() + 4, buffer.size());
-        // Read the PointCloud2 message from the stream
-        read(stream, point_cloud_msg, key_mode::not_key);
+
+    // Decode the PointCloud2 messages
+    auto point_cloud_handler = [voxel_size](const Timed<zenoh::Sample> &timed, TopicMetrics &metrics) {
+        const zenoh::Sample &sample = timed.value;
+        int64_t queue_ns = system_time_ns() - timed.received_ns;
+        auto start = std::chrono::steady_clock::now();
+
+        std::ostringstream out;
+        out << ">> [Point Cloud Subscriber] Zenoh key: " << sample.get_keyexpr().as_string_view()
+            << ", Size: " << sample.get_payload().size() << "\n";
+
+        // Decode the CDR payload in place: the point data is not copied
+        PayloadView payload(sample.get_payload());
+        PointCloud2View point_cloud;
+        try {
+            point_cloud = PointCloud2View::parse(payload.span());
+        } catch (const std::exception &e) {
+            std::cerr << "   Failed to decode PointCloud2: " << e.what() << std::endl;
+            metrics.record_error(payload.size());
+            return;
+        }
+        int64_t decode_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now() - start).count();
+        const auto &stamp = point_cloud.header().stamp;
+        std::optional<int64_t> latency_ns;
+        if (stamp.sec != 0 || stamp.nanosec != 0) {
+            latency_ns = timed.received_ns - stamp_ns(stamp.sec, stamp.nanosec);
+        }
+        metrics.record(payload.size(), queue_ns, decode_ns, latency_ns);
 
         // Print some information about the PointCloud2 message
-        std::cout << "   Time=" << point_cloud_msg.header().stamp() 
-                  << ", Height=" << point_cloud_msg.height()
-                  << ", Width=" << point_cloud_msg.width() << std::endl;
+        out << "   Time=" << point_cloud.header().stamp
+            << ", Height=" << point_cloud.height()
+            << ", Width=" << point_cloud.width()
+            << ", Fields=" << point_cloud.fields().size()
+            << ", Data=" << point_cloud.data().size << (payload.shared_memory() ? " (shared memory)" : "") << "\n";
+
+        // Unpack the points and downsample them
+        if (voxel_size > 0) {
+            // Each worker reuses its own buffers from one cloud to the next
+            thread_local PointLayoutCache layouts;
+            thread_local PointCloudSoA points;
+            thread_local PointCloudSoA downsampled;
+            thread_local VoxelGrid voxel_grid(voxel_size);
+            const auto &layout = layouts.get(point_cloud);
+            if (layout.has_value()) {
+                unpack_points(point_cloud, *layout, points);
+                voxel_grid.downsample(points, downsampled);
+                out << "   Points=" << points.size() << ", Downsampled=" << downsampled.size() << "\n";
+            } else {
+                out << "   No usable x/y/z fields\n";
+            }
+        }
+        std::cout << out.str();
     }; 
-    auto point_cloud_subscriber = session.declare_subscriber(
+
+    // The subscriptions to the hard-coded topics, when the graph isn't discovered.
+    // The handlers run on their own workers, the Zenoh callbacks only hand the samples over.
+    // Cloning a sample only takes a reference on its payload.
+    std::optional<SamplePipeline> tf_pipeline;
+    std::optional<SamplePipeline> point_cloud_pipeline;
+    std::optional<SamplePipeline> tf_static_pipeline;
+    std::optional<zenoh::Subscriber<void>> tf_subscriber;
+    std::optional<zenoh::Subscriber<void>> point_cloud_subscriber;
+    std::optional<zenoh::ext::AdvancedSubscriber<void>> tf_querying_sub;
+    // Otherwise, the subscriptions to all the topics of the known types found in the graph
+    std::unique_ptr<RosDiscovery> discovery;
+
+    if (discovery_mode) {
+        discovery = std::make_unique<RosDiscovery>(session, ROS_DOMAIN_ID, metrics, nb_workers, recorder.get());
+        discovery->add_type(TF_MESSAGE_TYPE, DISCOVERY_TF_QUEUE_DEPTH, DISCOVERY_TF_HISTORY_DEPTH,
+                            [&tf_handler](const Timed<zenoh::Sample> &timed, DiscoveredTopic &topic) {
+                                tf_handler(timed, topic.metrics, topic.transient_local);
+                            });
+        discovery->add_type(POINT_CLOUD2_TYPE, DISCOVERY_POINT_CLOUD_QUEUE_DEPTH, DISCOVERY_POINT_CLOUD_HISTORY_DEPTH,
+                            [&point_cloud_handler](const Timed<zenoh::Sample> &timed, DiscoveredTopic &topic) {
+                                point_cloud_handler(timed, topic.metrics);
+                            });
+        discovery->start();
+    } else {
+        // Subscribe to /tf
+        zenoh::KeyExpr tf_keyexpr(ROS_TOPIC_TF);
+        auto &tf_metrics = metrics.add("tf");
+        auto tf_qos = parse_qos_history(QOS_TF, HISTORY_DEPTH);
+        size_t tf_depth = tf_qos.depth;
+        auto tf_policy = overflow_policy_for(tf_qos);
+        tf_pipeline.emplace("tf", tf_depth, tf_policy, nb_workers,
+                            [&tf_handler, &tf_metrics](const Timed<zenoh::Sample> &timed) {
+                                tf_handler(timed, tf_metrics, false);
+                            });
+        tf_metrics.track_queue(*tf_pipeline);
+        tf_subscriber.emplace(session.declare_subscriber(
+                                    tf_keyexpr,               // TF key expression
+                                    [&tf_pipeline, &recorder](const zenoh::Sample &sample) {
+                                        if (recorder) {
+                                            recorder->record(sample, TF_MESSAGE_TYPE);
+                                        }
+                                        tf_pipeline->push({sample.clone(), system_time_ns()});
+                                    },
+                                    zenoh::closures::none     // Drop callback which is not used
+                                 ));
+
+        // Subscribe to /point_cloud
+        zenoh::KeyExpr point_cloud_keyexpr(ROS_TOPIC_POINT_CLOUD);
+        auto &point_cloud_metrics = metrics.add("point_cloud");
+        auto point_cloud_qos = parse_qos_history(QOS_POINT_CLOUD, HISTORY_DEPTH);
+        size_t point_cloud_depth = point_cloud_qos.depth;
+        auto point_cloud_policy = overflow_policy_for(point_cloud_qos);
+        point_cloud_pipeline.emplace("point_cloud", point_cloud_depth, point_cloud_policy, nb_workers,
+                                     [&point_cloud_handler, &point_cloud_metrics](const Timed<zenoh::Sample> &timed) {
+                                         point_cloud_handler(timed, point_cloud_metrics);
+                                     });
+        point_cloud_metrics.track_queue(*point_cloud_pipeline);
+        point_cloud_subscriber.emplace(session.declare_subscriber(
                                             point_cloud_keyexpr,               // Point Cloud key expression
-                                            std::move(point_cloud_handler),    // The callback to receive sample
+                                            [&point_cloud_pipeline, &recorder](const zenoh::Sample &sample) {
+                                                if (recorder) {
+                                                    recorder->record(sample, POINT_CLOUD2_TYPE);
+                                                }
+                                                point_cloud_pipeline->push({sample.clone(), system_time_ns()});
+                                            },
                                             zenoh::closures::none              // Drop callback which is not used
-                                          );
-
-    // Subscribe to /tf_static
-    // Using advanced subscriber because /tf_static is a transient_local topic
-    using AdvancedSubscriberOptions = zenoh::ext::SessionExt::AdvancedSubscriberOptions;
-    auto adv_sub_opts = AdvancedSubscriberOptions::create_default();
-    // Allow this subscriber to be detected through liveliness.
-    adv_sub_opts.subscriber_detection = true;
-    adv_sub_opts.query_timeout_ms = std::numeric_limits<uint64_t>::max();
-    // History can only be retransmitted by Publishers that enable caching.
-    adv_sub_opts.history = AdvancedSubscriberOptions::HistoryOptions::create_default();
-    // Enable detection of late joiner publishers and query for their historical data.
-    adv_sub_opts.history->detect_late_publishers = true;
-    adv_sub_opts.history->max_samples = HISTORY_DEPTH;
-    // Only needed if the topic is reliable.
-    adv_sub_opts.recovery.emplace().last_sample_miss_detection =
-      AdvancedSubscriberOptions::RecoveryOptions::Heartbeat{};
-    zenoh::KeyExpr tf_static_keyexpr(ROS_TOPIC_TF_STATIC);
-    auto tf_querying_sub = session.ext().declare_advanced_subscriber(
-                                            tf_static_keyexpr,        // Point Cloud key expression
-                                            std::move(tf_handler),    // The callback to receive sample
+                                          ));
+
+        // Subscribe to /tf_static
+        // Using advanced subscriber because /tf_static is a transient_local topic
+        using AdvancedSubscriberOptions = zenoh::ext::SessionExt::AdvancedSubscriberOptions;
+        auto adv_sub_opts = AdvancedSubscriberOptions::create_default();
+        // Allow this subscriber to be detected through liveliness.
+        adv_sub_opts.subscriber_detection = true;
+        adv_sub_opts.query_timeout_ms = std::numeric_limits<uint64_t>::max();
+        // History can only be retransmitted by Publishers that enable caching.
+        adv_sub_opts.history = AdvancedSubscriberOptions::HistoryOptions::create_default();
+        // Enable detection of late joiner publishers and query for their historical data.
+        adv_sub_opts.history->detect_late_publishers = true;
+        adv_sub_opts.history->max_samples = HISTORY_DEPTH;
+        // Only needed if the topic is reliable.
+        adv_sub_opts.recovery.emplace().last_sample_miss_detection =
+          AdvancedSubscriberOptions::RecoveryOptions::Heartbeat{};
+        // The history of a transient local topic arrives as a burst when publishers are discovered:
+        // make room for all of it, not only for the depth of a single publisher.
+        auto &tf_static_metrics = metrics.add("tf_static");
+        auto tf_static_qos = parse_qos_history(QOS_TF_STATIC, HISTORY_DEPTH);
+        size_t tf_static_depth = std::max<size_t>(tf_static_qos.depth, HISTORY_DEPTH);
+        auto tf_static_policy = overflow_policy_for(tf_static_qos);
+        tf_static_pipeline.emplace("tf_static", tf_static_depth, tf_static_policy, nb_workers,
+                                   [&tf_handler, &tf_static_metrics](const Timed<zenoh::Sample> &timed) {
+                                       tf_handler(timed, tf_static_metrics, true);
+                                   });
+        tf_static_metrics.track_queue(*tf_static_pipeline);
+        zenoh::KeyExpr tf_static_keyexpr(ROS_TOPIC_TF_STATIC);
+        tf_querying_sub.emplace(session.ext().declare_advanced_subscriber(
+                                            tf_static_keyexpr,        // TF static key expression
+                                            [&tf_static_pipeline, &recorder](const zenoh::Sample &sample) {
+                                                if (recorder) {
+                                                    recorder->record(sample, TF_MESSAGE_TYPE);
+                                                }
+                                                tf_static_pipeline->push({sample.clone(), system_time_ns()});
+                                            },
                                             zenoh::closures::none,    // Drop callback which is not used
                                             std::move(adv_sub_opts)   // Advanced Subscriber configuration
-                                         );
+                                         ));
+        // Count the samples lost on the way, detected from the gaps in the sequence numbers of the publishers
+        tf_querying_sub->declare_background_sample_miss_listener(
+                            [&tf_static_metrics](const zenoh::ext::Miss &miss) { tf_static_metrics.record_missed(miss.nb); },
+                            zenoh::closures::none
+                        );
+    }
+
+    // Expose the statistics of the subscriptions, e.g. `z_get -s '@zenoh_ros_sub/*/stats'`
+    std::stringstream ss_zid;
+    ss_zid << session.get_zid();
+    std::string zid = ss_zid.str();
+    std::string stats_key = "@zenoh_ros_sub/" + zid + "/stats";
+    auto stats_queryable = session.declare_queryable(
+                                zenoh::KeyExpr(stats_key),
+                                [&metrics, stats_key, zid](const zenoh::Query &query) {
+                                    query.reply(zenoh::KeyExpr(stats_key), zenoh::Bytes(metrics.to_json(zid)));
+                                },
+                                zenoh::closures::none
+                            );
 
     // Declare a liveliness token for the detection.
     // Note that this can only work in ROS 2 Jazzy while Humble has different liveliness token format.
@@ -160,49 +434,120 @@ int main(int argc, char **argv)
     //   https://github.com/ros2/rmw_zenoh/blob/rolling/docs/design.md#graph-cache
     // QoS settings for the liveliness token
     //   https://github.com/ros2/rmw_zenoh/blob/cdb66eed88a41775e4d6b7a3919805d4963f606b/rmw_zenoh_cpp/src/detail/liveliness_utils.cpp#L239
+    std::vector<zenoh::LivelinessToken> liveliness_tokens;
+    auto declare_token = [&session, &liveliness_tokens](const std::string &key) {
+        liveliness_tokens.push_back(session.liveliness_declare_token(
+          zenoh::KeyExpr(key),
+          zenoh::Session::LivelinessDeclarationOptions::create_default()));
+    };
     // Node liveliness token
     int node_id = get_next_entities_id();
     std::stringstream ss_node;
-    ss_node << "@ros2_lv/0/" << session.get_zid() << "/" << node_id << "/" << node_id 
+    ss_node << "@ros2_lv/" ROS_DOMAIN_ID "/" << session.get_zid() << "/" << node_id << "/" << node_id 
             << "/NN/%/%/" << NODE_NAME;
-    auto liveliness_token_node = session.liveliness_declare_token(
-      zenoh::KeyExpr(ss_node.str()),
-      zenoh::Session::LivelinessDeclarationOptions::create_default());
-    // TF liveliness token
-    std::stringstream ss_tf;
-    ss_tf << "@ros2_lv/0/" << session.get_zid() << "/" << node_id << "/" << get_next_entities_id()
-          << "/MS/%/%/" << NODE_NAME << "/" << MANGLED_TF << "/tf2_msgs::msg::dds_::TFMessage_/RIHS01_e369d0f05a23ae52508854b66f6aa0437f3449d652e8cbf22d5abe85d020f087/::,100:,:,:,,";
-    auto liveliness_token_tf = session.liveliness_declare_token(
-      zenoh::KeyExpr(ss_tf.str()),
-      zenoh::Session::LivelinessDeclarationOptions::create_default());
-    // TF static liveliness token
-    std::stringstream ss_tf_static;
-    ss_tf_static << "@ros2_lv/0/" << session.get_zid() << "/" << node_id << "/" << get_next_entities_id()
-                 << "/MS/%/%/" << NODE_NAME << "/" << MANGLED_TF_STATIC << "/tf2_msgs::msg::dds_::TFMessage_/RIHS01_e369d0f05a23ae52508854b66f6aa0437f3449d652e8cbf22d5abe85d020f087/:1:,1:,:,:,,";
-    auto liveliness_token_tf_static = session.liveliness_declare_token(
-      zenoh::KeyExpr(ss_tf_static.str()),
-      zenoh::Session::LivelinessDeclarationOptions::create_default());
-    // Point Cloud liveliness token
-    std::stringstream ss_point_cloud;
-    ss_point_cloud << "@ros2_lv/0/" << session.get_zid() << "/" << node_id << "/" << get_next_entities_id()
-                   << "/MS/%/%/" << NODE_NAME << "/" << MANGLED_POINT_CLOUD
-                   << "/sensor_msgs::msg::dds_::PointCloud2_/RIHS01_9198cabf7da3796ae6fe19c4cb3bdd3525492988c70522628af5daa124bae2b5/::,5:,:,:,,";   // Volatile, Keep last 5
-                   //<< "/sensor_msgs::msg::dds_::PointCloud2_/RIHS01_9198cabf7da3796ae6fe19c4cb3bdd3525492988c70522628af5daa124bae2b5/:1:,1:,:,:,,";   // Transient Local, Keep last 1
-    auto liveliness_token_point_cloud = session.liveliness_declare_token(
-      zenoh::KeyExpr(ss_point_cloud.str()),
-      zenoh::Session::LivelinessDeclarationOptions::create_default());
+    declare_token(ss_node.str());
+    // The discovered topics are many and change over time: only the node is announced
+    if (!discovery_mode) {
+        // TF liveliness token
+        std::stringstream ss_tf;
+        ss_tf << "@ros2_lv/" ROS_DOMAIN_ID "/" << session.get_zid() << "/" << node_id << "/" << get_next_entities_id()
+              << "/MS/%/%/" << NODE_NAME << "/" << MANGLED_TF << "/" << TF_MESSAGE_TYPE_NAME << "/" << TF_MESSAGE_TYPE_HASH << "/" << QOS_TF;
+        declare_token(ss_tf.str());
+        // TF static liveliness token
+        std::stringstream ss_tf_static;
+        ss_tf_static << "@ros2_lv/" ROS_DOMAIN_ID "/" << session.get_zid() << "/" << node_id << "/" << get_next_entities_id()
+                     << "/MS/%/%/" << NODE_NAME << "/" << MANGLED_TF_STATIC << "/" << TF_MESSAGE_TYPE_NAME << "/" << TF_MESSAGE_TYPE_HASH << "/" << QOS_TF_STATIC;
+        declare_token(ss_tf_static.str());
+        // Point Cloud liveliness token
+        std::stringstream ss_point_cloud;
+        ss_point_cloud << "@ros2_lv/" ROS_DOMAIN_ID "/" << session.get_zid() << "/" << node_id << "/" << get_next_entities_id()
+                       << "/MS/%/%/" << NODE_NAME << "/" << MANGLED_POINT_CLOUD
+                       << "/" << POINT_CLOUD2_TYPE_NAME << "/" << POINT_CLOUD2_TYPE_HASH << "/" << QOS_POINT_CLOUD;
+        declare_token(ss_point_cloud.str());
+    }
 
     // Waiting for CTRL-C to exit
     std::cout << "Press CTRL-C to quit...\n";
-    while (true) {
+    const auto &tf_lookups = args.values("tf-lookup");
+    // The statistics are still collected every second for the queryable when they're not printed
+    auto stats_interval = stats_period > 0 ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                 std::chrono::duration<double>(stats_period))
+                                           : std::chrono::steady_clock::duration(1s);
+    auto next_stats = std::chrono::steady_clock::now() + stats_interval;
+    while (running) {
         std::this_thread::sleep_for(1s);
+
+        // Write the static transforms received since the last second, if they changed the tree
+        if (tf_static_snapshot) {
+            try {
+                tf_static_snapshot->save_if_changed();
+            } catch (const std::exception &e) {
+                std::cerr << "Failed to save the tf_static snapshot: " << e.what() << std::endl;
+            }
+        }
+
+        // Print the statistics of the last period
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next_stats) {
+            auto report = metrics.report();
+            if (stats_period > 0) {
+                std::cout << report;
+                if (recorder) {
+                    std::cout << ">> [Stats] recorder: " << recorder->recorded() << " samples written, "
+                              << recorder->dropped() << " dropped, " << recorder->errors()
+                              << " not written\n";
+                }
+                if (tf_static_snapshot) {
+                    std::cout << ">> [Stats] tf_static snapshot: " << tf_static_snapshot->size() << " transforms, "
+                              << tf_static_snapshot->confirmed() << " loaded ones confirmed\n";
+                }
+                if (discovery) {
+                    std::cout << ">> [Stats] discovery: " << discovery->graph().nb_entities() << " entities, "
+                              << discovery->nb_topics() << " topics on " << discovery->nb_subscribers()
+                              << " subscriptions, " << discovery->dropped() << " dropped\n";
+                }
+            }
+            next_stats = now + stats_interval;
+        }
+
+        // Print the requested transforms
+        for (auto lookup : tf_lookups) {
+            auto pos = lookup.find(':');
+            if (pos == std::string_view::npos) {
+                std::cerr << "Invalid --tf-lookup '" << lookup << "', expected TARGET:SOURCE" << std::endl;
+                continue;
+            }
+            auto target = lookup.substr(0, pos);
+            auto source = lookup.substr(pos + 1);
+            TfError error;
+            auto tf = tf_buffer.lookup(target, source, 0, &error);
+            std::ostringstream out;
+            out << ">> [TF Lookup] " << target << " <- " << source << ": ";
+            if (tf.has_value()) {
+                out << "Translation: (" << tf->translation.x << ", " << tf->translation.y << ", "
+                    << tf->translation.z << "), Rotation: (" << tf->rotation.x << ", " << tf->rotation.y << ", "
+                    << tf->rotation.z << ", " << tf->rotation.w << ")\n";
+            } else {
+                out << to_string(error) << "\n";
+            }
+            std::cout << out.str();
+        }
     }
 
-    // Undeclare the liveliness token when exiting
-    std::move(liveliness_token_point_cloud).undeclare();
-    std::move(liveliness_token_tf_static).undeclare();
-    std::move(liveliness_token_tf).undeclare();
-    std::move(liveliness_token_node).undeclare();
+    // Keep the static transforms received during the last second
+    if (tf_static_snapshot) {
+        try {
+            tf_static_snapshot->save_if_changed();
+        } catch (const std::exception &e) {
+            std::cerr << "Failed to save the tf_static snapshot: " << e.what() << std::endl;
+        }
+    }
+
+    // Undeclare the liveliness tokens when exiting, the node last
+    while (!liveliness_tokens.empty()) {
+        std::move(liveliness_tokens.back()).undeclare();
+        liveliness_tokens.pop_back();
+    }
 
     return 0;
 }
\ No newline at end of file